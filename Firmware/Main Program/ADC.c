@@ -5,30 +5,109 @@
 
 #include <xc.h>
 #include "config.h"
+#include "pin_defs.h"
 #include "ADC.h"
 
+// Scan order, results are stored at the same index
+const u8 ADCchannels[ADC_SCAN_COUNT] = { LX_CH, LY_CH, RX_CH, RY_CH, LT_CH, RT_CH };
+
+// Completed sample sets, the ISR fills one bank while the other is read
+volatile u16 ADCresult[2][ADC_SCAN_COUNT];
+volatile u8 ADCbank;    // Bank holding the latest complete set
+volatile u8 ADCseq;     // Incremented each time a set is completed
+u8 ADCindex;            // Channel currently being converted
+u8 ADCshift;            // Scales short bursts up to ADC_FRAC_BITS fraction bits
+
+// TMR2 postscaler for each filter depth, ~200 us of conversions per sample
+// across the six channels must fit in the scan period
+const u8 ADCscanPost[ADC_FILTER_MAX + 1] = { 0, 0, 0, 1, 3 };
+
 void ADCinit()
 {
-    ADCON0 = 0b00000100;    // ADGO cleared after each conversion, ADC clock supplied by FOSC, Right-justified result
+    ADCON0 = 0b00010100;    // ADGO cleared after each conversion, ADC clock supplied by ADCRC, Right-justified result
     ADCON1 = 0b00000000;    // One conversion for each trigger
-    ADCON2 = 0b00000000;    // ADC Mode 0 (Basic Mode)
+    ADCON2 = 0b00000011;    // ADC Mode 3 (Burst Average Mode), no result shift
+    ADCON3 = 0b00000111;    // ADTIF set after every completed burst
+    ADRPT = 1;              // Single conversion per burst until a filter depth is set
     ADREF = 0b00000000;     // VREF on VSS and VDD 
-    ADCLK = 0b00000111;     // ADC running at FOSC/16
+    ADPRE = 0x00;           // No precharge time
+    ADACQ = ADC_ACQ_TAD;    // Acquisition time for the joystick/trigger potentiometers
+    ADPCH = ADCchannels[0];
+    ADACT = 0b00000100;     // Conversion triggered by the postscaled TMR2 output
+    
+    ADCindex = 0;
+    ADCbank = 0;
+    ADCseq = 0;
+    ADCshift = ADC_FRAC_BITS;
+    
+    // Scan trigger: TMR2 on MFINTOSC with 1:2 prescaler
+    T2CLKCON = 0b00000101;
+    T2HLT = 0b00000000;     // Free-running period mode
+    T2PR = (MFINTOSC_FREQ / (2 * ADC_SCAN_RATE)) - 1;
+    T2CON = 0b10010000;     // TMR2 on, 1:2 prescaler, 1:1 postscaler
+    
+    ADTIF = 0;
+    PIE1bits.ADTIE = 1;
     ADCON0bits.ADON = 1;    // Turn on ADC module
 }
 
-u16 ADCread(u8 channel)
+void ADCsetFilter(u8 depth)
 {
-    u16 result;
+    if (depth > ADC_FILTER_MAX) depth = ADC_FILTER_DEFAULT;
     
-    ADPRE = 0x00;           // No precharge time
-    ADACQ = 255;            // Maximum acquisition time (255 TAD cycles)
-    ADPCH = channel & 0x3F; // Select ADC channel
+    // Stop scanning while the burst length changes, restart from the first channel
+    PIE1bits.ADTIE = 0;
+    ADCON0bits.ADON = 0;
+    ADTIF = 0;
+    ADCindex = 0;
+    ADPCH = ADCchannels[0];
     
-    ADCON0bits.ADGO = 1;    // Begin conversion
-    while(ADCON0bits.ADGO); // Wait for conversion
+    ADRPT = 1 << depth;             // Conversions per burst
+    // Accumulated sum shifted down to a 12-bit average, shorter bursts are shifted up in the ISR
+    ADCON2bits.ADCRS = (depth > ADC_FRAC_BITS) ? (depth - ADC_FRAC_BITS) : 0;
+    ADCshift = (depth < ADC_FRAC_BITS) ? (ADC_FRAC_BITS - depth) : 0;
+    T2CONbits.OUTPS = ADCscanPost[depth];
     
-    result = (ADRESH << 8) | ADRESL;
+    PIE1bits.ADTIE = 1;
+    ADCON0bits.ADON = 1;
+}
+
+void ADCscanHandle()
+{
+    u8 bank = ADCbank ^ 1;
+    
+    ADCresult[bank][ADCindex] = ((ADFLTRH << 8) | ADFLTRL) << ADCshift;
+    ADCindex++;
+    
+    if (ADCindex < ADC_SCAN_COUNT)
+    {
+        // Convert next channel right away
+        ADPCH = ADCchannels[ADCindex];
+        ADCON0bits.ADGO = 1;
+    }
+    else
+    {
+        // Publish complete set, first channel waits for the next trigger
+        ADCindex = 0;
+        ADPCH = ADCchannels[0];
+        ADCbank = bank;
+        ADCseq++;
+    }
+}
+
+void ADCscanRead(u16 *buf)
+{
+    u8 seq;
+    u8 i;
     
-    return result;          // Return 10-bit result
+    // Retry if a new set was published part way through the copy
+    do
+    {
+        seq = ADCseq;
+        for (i = 0; i < ADC_SCAN_COUNT; i++)
+        {
+            buf[i] = ADCresult[ADCbank][i];
+        }
+    } 
+    while (seq != ADCseq);
 }
@@ -6,8 +6,38 @@
 #ifndef _ADC_H_
 #define	_ADC_H_
 
+// Complete scans of all axis channels per second
+#define ADC_SCAN_RATE   1000
+
+// Acquisition time in ADCRC periods (~1.6 us each), covers the ~5.5 us
+// needed for a 10k potentiometer (2.5k worst-case source impedance)
+#define ADC_ACQ_TAD     4
+
+// Hardware filter depth, each scan step averages 2^depth conversions of one
+// channel (ADCC Burst Average Mode). Scans that outlast the trigger period
+// are stretched to a multiple of it, see ADCscanPost.
+#define ADC_FILTER_MAX      4
+#define ADC_FILTER_DEFAULT  2
+
+// Results keep 2 bits below the 10-bit conversion (12-bit scale), so the
+// averaged bursts still carry their extra resolution when rounded to 8 bits
+#define ADC_FRAC_BITS       2
+
+// Scan result positions
+#define ADC_LX  0
+#define ADC_LY  1
+#define ADC_RX  2
+#define ADC_RY  3
+#define ADC_LT  4
+#define ADC_RT  5
+#define ADC_SCAN_COUNT  6
+
 void ADCinit();
 
-u16 ADCread(u8 channel);
+void ADCsetFilter(u8 depth);
+
+void ADCscanHandle();
+
+void ADCscanRead(u16 *buf);
 
 #endif  /* _ADC_H_ */
\ No newline at end of file
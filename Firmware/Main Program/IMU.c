@@ -7,44 +7,98 @@
 #include "pin_defs.h"
 #include "config.h"
 #include "MSSP.h"
+#include "input.h"
 #include "IMU.h"
 
+// Boot waits in input time counts
+#define IMU_BOOT_MIN_TICKS  ((u16)(INPUT_TIME_RATE / 1000 * IMU_BOOT_MIN_MS))
+#define IMU_BOOT_TICKS      ((u16)(INPUT_TIME_RATE / 1000 * IMU_BOOT_MS))
+
 u8 IMUen;
+u8 IMUbooting;      // Waiting for the IMU to answer
+u16 IMUbootStart;   // Input time of IMUinit()
+u8 IMUscale = XL_OFF;
+u8 IMUgScale = G_OFF;
+u8 IMUprofile = IMU_PROFILE_DIRECT;
+
+// Accelerometer and FIFO data rate (ODR_XL / ODR_FIFO)
+const u8 IMUprofileODR[IMU_PROFILE_COUNT] = { 0b1000, 0b0111, 0b0110, 0b0111 };
+
+// CTRL8_XL, LPF2 enable and cutoff (ODR / 9 or ODR / 50)
+const u8 IMUprofileLPF[IMU_PROFILE_COUNT] = { 0x00, 0xC0, 0xC0, 0x80 };
+
+// Samples averaged per reading (2^n)
+const u8 IMUprofileAvg[IMU_PROFILE_COUNT] = { 0, 2, 1, 2 };
+
+static void IMUapplyProfile()
+{
+    u8 odr = IMUprofileODR[IMUprofile];
+    
+    IMUwriteReg(FIFO_CTRL5, 0x00);                                      // FIFO bypass, clears it
+    
+    if (IMUscale == XL_OFF) IMUwriteReg(CTRL1_XL, 0x00);                // Accel off
+    else IMUwriteReg(CTRL1_XL, (odr << 4) | ((IMUscale & 0x03) << 2));  // Accel at the profile data rate
+    
+    IMUwriteReg(CTRL8_XL, IMUprofileLPF[IMUprofile]);
+    
+    if ((IMUprofile != IMU_PROFILE_DIRECT) && (IMUscale != XL_OFF))
+    {
+        IMUwriteReg(FIFO_CTRL1, 3 << IMUprofileAvg[IMUprofile]);       // Watermark at one batch of words
+        IMUwriteReg(FIFO_CTRL2, 0x00);
+        IMUwriteReg(FIFO_CTRL3, 0x01);                                  // Accel in FIFO, no decimation
+        IMUwriteReg(FIFO_CTRL5, (odr << 3) | 0x06);                     // Continuous mode at the accel data rate
+    }
+}
 
-u8 IMUinit(u8 aScale, u8 gScale)
+void IMUinit(u8 aScale, u8 gScale)
 {
     if (!SPIisEnabled()) 
     {
         SPImasterInit(IMU_SPI_CLK, 0, 1, 0);
     }
     
-    // Give IMU time to initialize
-    __delay_ms(50);
+    // Configured by IMUtask() once the IMU answers, accelerometer reads as neutral until then
+    IMUscale = aScale;
+    IMUgScale = gScale;
+    IMUen = 0;
+    IMUbooting = 1;
+    IMUbootStart = InputGetTime();
+}
+
+void IMUtask()
+{
+    u16 elapsed;
+    
+    if (!IMUbooting) return;
     
-    /* Disable IMU and return if device is not recognized */
+    // Leave the IMU alone until its boot procedure has finished
+    elapsed = InputGetTime() - IMUbootStart;
+    if (elapsed < IMU_BOOT_MIN_TICKS) return;
+    
+    // Disable IMU if device is not recognized within its turn-on time
     if (IMUreadReg(ID_REG) != IMU_ID)
     {
-        IMUoff();
-        return 1;
+        if (elapsed >= IMU_BOOT_TICKS) IMUoff();
+        return;
     }
     
     IMUwriteReg(INT1_CTRL, 0x03);                               // Accel Data Ready and Gyro Data Ready on INT1
     
-    if (aScale == XL_OFF) IMUwriteReg(CTRL1_XL, 0x00);          // Accel off
-    else IMUwriteReg(CTRL1_XL, 0x80 | (aScale & 0x03));         // Accel 1.66 kHz data rate
+    IMUapplyProfile();                                          // Accel data rate, filter and FIFO
     
-    if (gScale == G_OFF) IMUwriteReg(CTRL2_G, 0x00);            // Gyro off
-    else IMUwriteReg(CTRL2_G, 0x80 | ((gScale & 0x07) << 1));   // Gyro 1.66 kHz data rate
+    if (IMUgScale == G_OFF) IMUwriteReg(CTRL2_G, 0x00);         // Gyro off
+    else IMUwriteReg(CTRL2_G, 0x80 | ((IMUgScale & 0x07) << 1)); // Gyro 1.66 kHz data rate
     
-    IMUwriteReg(CTRL3_C, 0x04);                                 // Continuous update, interrupt active high, 4-wire SPI
+    IMUwriteReg(CTRL3_C, 0x44);                                 // Block data update, interrupt active high, 4-wire SPI
     
+    IMUbooting = 0;
     IMUen = 1;
-    return 0;
 }
 
 void IMUoff()
 {
     SPIoff();
+    IMUbooting = 0;
     IMUen = 0;
 }
 
@@ -53,6 +107,20 @@ u8 IMUisEnabled()
     return IMUen;
 }
 
+u8 IMUisStarting()
+{
+    return IMUbooting;
+}
+
+void IMUsetProfile(u8 profile)
+{
+    // Also covers erased EEPROM
+    if (profile >= IMU_PROFILE_COUNT) profile = IMU_PROFILE_DIRECT;
+    
+    IMUprofile = profile;
+    if (IMUen) IMUapplyProfile();
+}
+
 void IMUwriteReg(u8 reg, u8 data)
 {
     CS = 0;
@@ -93,25 +161,79 @@ void IMUreadRegMulti(u8 reg, u8 *data, u8 len)
     CS = 1;
 }
 
-s16 IMUreadAccelX()
-{
-    u8 data[2];
-    IMUreadRegMulti(OUTX_L_XL, data, 2);
-    return data[0] | (data[1] << 8);
-}
-
-s16 IMUreadAccelY()
-{
-    u8 data[2];
-    IMUreadRegMulti(OUTY_L_XL, data, 2);
-    return data[0] | (data[1] << 8);
-}
-
-s16 IMUreadAccelZ()
+u8 IMUreadAccel(s16 *xyz)
 {
-    u8 data[2];
-    IMUreadRegMulti(OUTZ_L_XL, data, 2);
-    return data[0] | (data[1] << 8);
+    u8 data[6];
+    u8 avg = IMUprofileAvg[IMUprofile];
+    u8 batch = 3 << avg;
+    u8 axis;
+    u16 words;
+    u16 skip;
+    s32 sum[3];
+    
+    if (IMUprofile == IMU_PROFILE_DIRECT)
+    {
+        // Nothing to read until a new sample is ready
+        if (!(IMUreadReg(STATUS_REG) & STATUS_XLDA)) return 0;
+        
+        // X, Y and Z of the same sample in one burst
+        IMUreadRegMulti(OUTX_L_XL, data, 6);
+        xyz[0] = data[0] | (data[1] << 8);
+        xyz[1] = data[2] | (data[3] << 8);
+        xyz[2] = data[4] | (data[5] << 8);
+        
+        return 1;
+    }
+    
+    // Nothing to read until a batch is waiting
+    if (!(IMUreadReg(FIFO_STATUS2) & FIFO_WTM)) return 0;
+    
+    // Unread FIFO words and the axis of the next one
+    IMUreadRegMulti(FIFO_STATUS1, data, 3);
+    words = ((u16)(data[1] & 0x0F) << 8) | data[0];
+    skip = data[2] ? 3 - data[2] : 0;
+    
+    // Wait for a full batch starting at X
+    if (words < skip + batch) return 0;
+    words -= skip;
+    
+    // Drop whole batches that are older than the newest one
+    while (words >= 2 * batch)
+    {
+        skip += batch;
+        words -= batch;
+    }
+    
+    // The address rolls back to FIFO_DATA_OUT_L, so the whole drain is one burst
+    CS = 0;
+    SPItransfer(SPI_READ | (IMU_REG_MASK & FIFO_DATA_OUT_L));
+    
+    while (skip--)
+    {
+        SPItransfer(SPI_NOP);
+        SPItransfer(SPI_NOP);
+    }
+    
+    sum[0] = 0;
+    sum[1] = 0;
+    sum[2] = 0;
+    axis = 0;
+    
+    while (batch--)
+    {
+        data[0] = SPItransfer(SPI_NOP);
+        data[1] = SPItransfer(SPI_NOP);
+        sum[axis] += (s16)(data[0] | (data[1] << 8));
+        if (++axis == 3) axis = 0;
+    }
+    
+    CS = 1;
+    
+    xyz[0] = sum[0] >> avg;
+    xyz[1] = sum[1] >> avg;
+    xyz[2] = sum[2] >> avg;
+    
+    return 1;
 }
 
 s16 IMUreadGyroX()
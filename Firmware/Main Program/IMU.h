@@ -12,8 +12,15 @@
 #define SPI_NOP         0xFF
 #define IMU_REG_MASK    0x7F
 
-// Master SPI CLK speed in Hz
-#define IMU_SPI_CLK     1000000
+// Master SPI CLK speed in Hz (LSM6DS3 maximum), the nearest rate below it is used
+#define IMU_SPI_CLK     10000000
+
+// IMU boot procedure in ms, registers may answer before it has finished so
+// configuration waits this long after IMUinit() at the least
+#define IMU_BOOT_MIN_MS 15
+
+// Longest IMU turn-on time in ms, the IMU is given up on if it has not answered by then
+#define IMU_BOOT_MS     50
 
 // +/- accelerometer scales
 #define XL_OFF          0xFF
@@ -30,7 +37,19 @@
 #define G_SCALE_1000DPS 0b100
 #define G_SCALE_2000DPS 0b110
 
+// Accelerometer profiles, see IMUprofile* in IMU.c
+#define IMU_PROFILE_DIRECT      0   // 1.66 kHz, latest sample
+#define IMU_PROFILE_FIFO_93HZ   1   // 833 Hz, 93 Hz low-pass, average of 4 from FIFO
+#define IMU_PROFILE_FIFO_46HZ   2   // 416 Hz, 46 Hz low-pass, average of 2 from FIFO
+#define IMU_PROFILE_FIFO_17HZ   3   // 833 Hz, 17 Hz low-pass, average of 4 from FIFO
+#define IMU_PROFILE_COUNT       4
+
 // LSM6DS3 register addresses
+#define FIFO_CTRL1      0x06
+#define FIFO_CTRL2      0x07
+#define FIFO_CTRL3      0x08
+#define FIFO_CTRL4      0x09
+#define FIFO_CTRL5      0x0A
 #define ORIENT_CFG_G    0x0B
 #define INT1_CTRL       0x0D
 #define INT2_CTRL       0x0E
@@ -59,15 +78,34 @@
 #define OUTY_H_XL       0x2B
 #define OUTZ_L_XL       0x2C
 #define OUTZ_H_XL       0x2D
+#define FIFO_STATUS1    0x3A
+#define FIFO_STATUS2    0x3B
+#define FIFO_STATUS3    0x3C
+#define FIFO_STATUS4    0x3D
+#define FIFO_DATA_OUT_L 0x3E
+#define FIFO_DATA_OUT_H 0x3F
 
 #define IMU_ID          0x69
 
-u8 IMUinit(u8 aScale, u8 gScale);
+// STATUS_REG bits
+#define STATUS_XLDA     0x01
+#define STATUS_GDA      0x02
+
+// FIFO_STATUS2 bits
+#define FIFO_WTM        0x80
+
+void IMUinit(u8 aScale, u8 gScale);
+
+void IMUtask();
 
 void IMUoff();
 
 u8 IMUisEnabled();
 
+u8 IMUisStarting();
+
+void IMUsetProfile(u8 profile);
+
 void IMUwriteReg(u8 reg, u8 data);
 
 void IMUwriteRegMulti(u8 reg, u8 *data, u8 len);
@@ -76,11 +114,7 @@ u8 IMUreadReg(u8 reg);
 
 void IMUreadRegMulti(u8 reg, u8 *data, u8 len);
 
-s16 IMUreadAccelX();
-
-s16 IMUreadAccelY();
-
-s16 IMUreadAccelZ();
+u8 IMUreadAccel(s16 *xyz);
 
 s16 IMUreadGyroX();
 
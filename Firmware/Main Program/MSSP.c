@@ -8,19 +8,91 @@
 #include "crypto.h"
 #include "expansion.h"
 #include "camera.h"
+#include "clock.h"
+#include "input.h"
+#include "prof.h"
 #include "MSSP.h"
 
-u8 I2Caddr;
-u8 I2CaddrSet;
+u32 SPIclk;         // Requested SPI clock in Hz
+u16 SPItimeout;     // SPIwait() polls, scaled to the byte time
 
 u8 I2Creg[512];
 u8 I2CregAddr;
 u8 I2CregAddrSet;
 
-u16 I2Cstatus;
+u8 I2Cdev;          // Device addressed by the current transfer, see I2C_DEV_*
+u8 I2Cenc;          // Expansion registers are encrypted on the bus
+u8 I2Cactive;       // Addressed since the last I2CwasActive()
+u8 I2Cserving;      // The current read started in a report window
+u8 I2Cconsumed;     // A report read ended since the last I2CwasConsumed()
+
+// Host polls: reads that start in the expansion report window
+u16 I2CpollTime;    // Input time of the last poll
+u16 I2CpollAge;     // Age of the report it was served
+u8 I2CpollCount;
+
+// Transaction trace, see I2C_TRACE_*
+u8 I2Ctracing;      // Records are being written
+u8 I2CtraceHead;    // Ring offset of the next record
+u8 I2CtraceLast;    // Ring offset of the last record
+u8 I2CtraceBytes;   // Data bytes since the last start
+u8 I2CtraceOpen;    // A start is recorded without its stop
+
+// Registers whose writes are passed on to the device emulator, one bit each
+u8 I2Chooks[2][32];
+// Registers the host can read but not write, one bit each
+u8 I2Clocked[2][32];
+const u8 I2Cbit[8] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+
+// Read bytes are plain loads from a run of consecutive registers found
+// ahead of time, so the next byte is always ready when the host asks
+u8 *I2CreadPtr;
+u8 I2CreadLeft;     // Bytes left in the run
+u8 I2CreadTmp;      // Single byte runs (encrypted on the fly or no device)
+
+// Report windows, one bank is served to the host, one holds the latest
+// published report and the main loop writes the third
+u8 I2CexpData[I2C_BANKS][I2C_EXP_DATA_SIZE];
+u8 I2CcamData[I2C_BANKS][I2C_CAM_DATA_SIZE];
+u8 *I2CexpFront;
+u8 *I2CcamFront;
+
+// Encrypted copies of the expansion report banks and of the calibration and
+// ID windows, so a read byte is a plain load. Kept in step with every write
+// while encryption is on, rebuilt by I2CencEnable() when it is switched on.
+u8 I2CexpEnc[I2C_BANKS][I2C_EXP_DATA_SIZE];
+u8 I2CencCal[I2C_ENC_CAL_SIZE];
+u8 I2CencID[I2C_ENC_ID_SIZE];
+u8 *I2CexpEncFront;
+
+// Bank roles for each window
+#define WIN_EXP 0
+#define WIN_CAM 1
+
+// Addressed devices
+#define I2C_DEV_EXP     0
+#define I2C_DEV_CAM     1
+#define I2C_DEV_NONE    2
+
+u8 I2Cfront[2];     // Served from the start of the current read
+u8 I2Cready[2];     // Latest published report
+u8 I2Cback[2];      // Written by the main loop
+u8 I2Cfresh[2];     // Ready bank is newer than the front bank
+u8 I2Cdirty[2];     // Back bank written since the last publish
+u16 I2CexpTime[I2C_BANKS];  // Input time each expansion bank was sampled at
+
+// Last report written to each window, a repeat of it is not written again
+u8 I2CexpLast[I2C_EXP_DATA_SIZE];
+u8 I2CcamLast[I2C_CAM_DATA_SIZE];
+u8 I2ClastPos[2];   // Offset of the last report in its window
+u8 I2ClastLen[2];   // Its length, 0 until one is written
+u32 I2CpubWrites[2];    // Reports written to each window
+u32 I2CpubSkips[2];     // Reports left out as unchanged
 
 void I2CslaveInit(const u8 addr1, const u8 addr2)
 {    
+    u8 w;
+    
     SSP1CON1bits.SSPEN = 0;
     
     SSP1CON1 = 0b01010110;      // 7-bit address slave mode with start/stop interrupts disabled
@@ -31,6 +103,39 @@ void I2CslaveInit(const u8 addr1, const u8 addr2)
     else SSP1MSK = 0xFF;
     SSP1STAT = 0b00000000;
     
+    // Emulators register their command and read-only registers again after this
+    for (w = 0; w < 32; w++)
+    {
+        I2Chooks[I2C_DEV_EXP][w] = 0;
+        I2Chooks[I2C_DEV_CAM][w] = 0;
+        I2Clocked[I2C_DEV_EXP][w] = 0;
+        I2Clocked[I2C_DEV_CAM][w] = 0;
+    }
+    I2Cdev = I2C_DEV_NONE;
+    I2Cenc = 0;
+    I2Cactive = 0;
+    I2Cserving = 0;
+    I2Cconsumed = 0;
+    I2CpollCount = 0;
+    
+    // Both windows start out serving bank 0
+    for (w = 0; w < 2; w++)
+    {
+        I2Cfront[w] = 0;
+        I2Cready[w] = 1;
+        I2Cback[w] = 2;
+        I2Cfresh[w] = 0;
+        I2Cdirty[w] = 0;
+        I2ClastLen[w] = 0;
+        I2CpubWrites[w] = 0;
+        I2CpubSkips[w] = 0;
+    }
+    I2CexpFront = I2CexpData[0];
+    I2CcamFront = I2CcamData[0];
+    I2CexpEncFront = I2CexpEnc[0];
+    
+    I2CtraceRun();
+    
     SSP1CON1bits.SSPEN = 1;
 }
 
@@ -44,6 +149,26 @@ u8 I2CisEnabled()
     return SSP1CON1bits.SSPEN;
 }
 
+static u8 *I2CencAddr(u8 addr)
+{
+    // Encrypted copy of an expansion register, if it has one
+    if ((u8)(addr - EXP_REG_CAL) < I2C_ENC_CAL_SIZE) return &I2CencCal[addr - EXP_REG_CAL];
+    if (addr >= EXP_REG_ID) return &I2CencID[addr - EXP_REG_ID];
+    return 0;
+}
+
+void I2CslaveHook(u16 addr)
+{
+    // Writes from the host to addr are passed to ExpCmdRcv() or CamCmdRcv()
+    I2Chooks[(addr >> 8) & 0x01][(u8)addr >> 3] |= I2Cbit[addr & 0x07];
+}
+
+void I2CslaveLock(u16 addr, u8 length)
+{
+    // Host writes to these registers are dropped, only the firmware sets them
+    for (; length; length--, addr++) I2Clocked[(addr >> 8) & 0x01][(u8)addr >> 3] |= I2Cbit[addr & 0x07];
+}
+
 u8 I2CslaveRead(u16 addr)
 {
     return I2Creg[addr & 0x1FF];
@@ -63,7 +188,16 @@ void I2CslaveReadMulti(u16 addr, u8 *buf, u8 length)
 
 void I2CslaveWrite(u16 addr, u8 data)
 {
+    u8 *enc;
+    
     I2Creg[addr & 0x1FF] = data;
+    
+    // Keep the encrypted copy in step
+    if (((addr & 0x1FF) < 256) && I2Cenc)
+    {
+        enc = I2CencAddr(addr);
+        if (enc) *enc = Encrypt(addr, data);
+    }
 }
 
 void I2CslaveWriteMulti(u16 addr, u8 *buf, u8 length)
@@ -73,103 +207,498 @@ void I2CslaveWriteMulti(u16 addr, u8 *buf, u8 length)
         u8 i;
         for (i = 0; i < length; i++)
         {
-            I2Creg[(addr & 0x1FF) + i] = buf[i];
+            I2CslaveWrite(addr + i, buf[i]);
+        }
+    }
+}
+
+static u8 *I2CreportAddr(u16 addr, u8 bank)
+{
+    addr &= 0x1FF;
+    
+    if (addr < EXP_REG_DATA + I2C_EXP_DATA_SIZE)
+    {
+        return &I2CexpData[bank][addr - EXP_REG_DATA];
+    }
+    
+    return &I2CcamData[bank][addr - CAM_REG_DATA - 256];
+}
+
+void I2CreportWrite(u16 addr, u8 *buf, u8 length)
+{
+    // Back bank of the window holding addr, never seen by the host
+    u8 w = ((addr & 0x1FF) < 256) ? WIN_EXP : WIN_CAM;
+    u8 pos = (w == WIN_EXP) ? (u8)addr - EXP_REG_DATA : (u8)addr - CAM_REG_DATA;
+    u8 *last = (w == WIN_EXP) ? &I2CexpLast[pos] : &I2CcamLast[pos];
+    u8 *dst;
+    u8 *enc;
+    u8 i;
+    
+    // The latest published report already holds these bytes
+    if ((I2ClastPos[w] == pos) && (I2ClastLen[w] == length))
+    {
+        for (i = 0; (i < length) && (last[i] == buf[i]); i++);
+        if (i == length)
+        {
+            I2CpubSkips[w]++;
+            return;
+        }
+    }
+    
+    dst = I2CreportAddr(addr, I2Cback[w]);
+    if ((w == WIN_EXP) && I2Cenc)
+    {
+        // Encrypt the expansion report here instead of per byte in the interrupt,
+        // the encrypted bank already matches every byte that did not change
+        enc = &I2CexpEnc[I2Cback[w]][pos];
+        for (i = 0; i < length; i++)
+        {
+            last[i] = buf[i];
+            if (dst[i] == buf[i]) continue;
+            dst[i] = buf[i];
+            enc[i] = Encrypt((u8)addr + i, buf[i]);
+        }
+    }
+    else
+    {
+        for (i = 0; i < length; i++)
+        {
+            dst[i] = buf[i];
+            last[i] = buf[i];
+        }
+    }
+    
+    I2ClastPos[w] = pos;
+    I2ClastLen[w] = length;
+    I2CpubWrites[w]++;
+    I2Cdirty[w] = 1;
+}
+
+void I2CreportSkip(u16 addr)
+{
+    // The caller knows its report is unchanged without packing it
+    I2CpubSkips[((addr & 0x1FF) < 256) ? WIN_EXP : WIN_CAM]++;
+}
+
+void I2CreportCounts(u32 *writes, u32 *skips)
+{
+    // Expansion window first, then camera
+    writes[0] = I2CpubWrites[WIN_EXP];
+    writes[1] = I2CpubWrites[WIN_CAM];
+    skips[0] = I2CpubSkips[WIN_EXP];
+    skips[1] = I2CpubSkips[WIN_CAM];
+}
+
+void I2CreportPublish(u16 time)
+{
+    u8 bank;
+    u8 w;
+    
+    // Swap the back and ready banks of each written window, the
+    // interrupt swaps ready and front at the next read
+    for (w = 0; w < 2; w++)
+    {
+        if (!I2Cdirty[w])
+        {
+            // Unchanged report, but sampled now: the bank the next read is served from is this fresh
+            if (w == WIN_EXP)
+            {
+                INTCONbits.GIE = 0;
+                I2CexpTime[I2Cfresh[w] ? I2Cready[w] : I2Cfront[w]] = time;
+                INTCONbits.GIE = 1;
+            }
+            continue;
         }
+        I2Cdirty[w] = 0;
+        if (w == WIN_EXP) I2CexpTime[I2Cback[w]] = time;
+        
+        INTCONbits.GIE = 0;
+        bank = I2Cready[w];
+        I2Cready[w] = I2Cback[w];
+        I2Cback[w] = bank;
+        I2Cfresh[w] = 1;
+        INTCONbits.GIE = 1;
     }
 }
 
+void I2CreportPatch(u8 addr, u8 data, u8 mask)
+{
+    // Interrupt only: edits the expansion bank being served, before its first byte goes out
+    u8 *dst = &I2CexpFront[addr - EXP_REG_DATA];
+    u8 value = (*dst & ~mask) | (data & mask);
+    
+    if (value == *dst) return;
+    *dst = value;
+    if (I2Cenc) I2CexpEncFront[addr - EXP_REG_DATA] = Encrypt(addr, value);
+}
+
+void I2CencEnable(u8 en)
+{
+    u8 bank;
+    u8 i;
+    
+    I2Cenc = 0;
+    if (!en) return;
+    
+    // Encrypt every mirrored byte with new keys. Encryption is still off, so
+    // the interrupt does not serve these copies meanwhile.
+    for (i = 0; i < I2C_ENC_CAL_SIZE; i++) I2CencCal[i] = Encrypt(EXP_REG_CAL + i, I2Creg[EXP_REG_CAL + i]);
+    for (i = 0; i < I2C_ENC_ID_SIZE; i++) I2CencID[i] = Encrypt(EXP_REG_ID + i, I2Creg[EXP_REG_ID + i]);
+    
+    // A read start patches the front report bank, and only keeps its twin in
+    // step once encryption is on. Publishing skips unchanged bytes, so a twin
+    // built before such a patch would stay stale: build them with the
+    // interrupt held off until encryption is on.
+    INTCONbits.GIE = 0;
+    for (bank = 0; bank < I2C_BANKS; bank++)
+    {
+        for (i = 0; i < I2C_EXP_DATA_SIZE; i++) I2CexpEnc[bank][i] = Encrypt(EXP_REG_DATA + i, I2CexpData[bank][i]);
+    }
+    I2Cenc = 1;
+    INTCONbits.GIE = 1;
+}
+
+static void I2CreportFlip(u8 w)
+{
+    u8 bank;
+    
+    if (!I2Cfresh[w]) return;
+    I2Cfresh[w] = 0;
+    
+    bank = I2Cfront[w];
+    I2Cfront[w] = I2Cready[w];
+    I2Cready[w] = bank;
+    
+    if (w == WIN_EXP)
+    {
+        I2CexpFront = I2CexpData[I2Cfront[w]];
+        I2CexpEncFront = I2CexpEnc[I2Cfront[w]];
+    }
+    else I2CcamFront = I2CcamData[I2Cfront[w]];
+}
+
+u8 I2CpollGet(u16 *time, u16 *age)
+{
+    INTCONbits.GIE = 0;
+    *time = I2CpollTime;
+    *age = I2CpollAge;
+    INTCONbits.GIE = 1;
+    
+    return I2CpollCount;
+}
+
+u8 I2CwasActive()
+{
+    u8 active = I2Cactive;
+    
+    I2Cactive = 0;
+    return active;
+}
+
+u8 I2CwasConsumed()
+{
+    // Only cleared once seen, a read ending in between is kept for the next call
+    if (!I2Cconsumed) return 0;
+    
+    I2Cconsumed = 0;
+    return 1;
+}
+
+u8 I2CconsumedPending()
+{
+    return I2Cconsumed;
+}
+
 void I2CslaveRelease()
 {
     SSP1CON1bits.CKP = 1;
+    PROF_RELEASE();
+}
+
+void I2CtraceRun()
+{
+    // Clears the ring and records from its start
+    u8 i;
+    
+    I2Ctracing = 0;
+    for (i = 0; i < I2C_TRACE_SIZE; i++) I2Creg[I2C_TRACE_BASE + i] = I2C_TRACE_EMPTY;
+    I2CtraceHead = 0;
+    I2CtraceLast = 0;
+    I2CtraceOpen = 0;
+    I2CslaveWrite(EXP_REG_TRACE_HEAD, 0);
+    I2Ctracing = 1;
+}
+
+void I2CtraceFreeze()
+{
+    // Recording stops, the host pages through the ring from the oldest record
+    I2Ctracing = 0;
+    I2CslaveWrite(EXP_REG_TRACE_HEAD, I2CtraceHead >> 2);
+}
+
+static void I2CtraceRecord(u8 event, u8 info)
+{
+    // Runs after the clock is released
+    u8 *rec;
+    u16 t;
+    
+    if (!I2Ctracing) return;
+    
+    t = InputGetTimeISR();
+    rec = &I2Creg[I2C_TRACE_BASE + I2CtraceHead];
+    rec[0] = event;
+    rec[1] = info;
+    rec[2] = t >> 8;
+    rec[3] = t;
+    
+    I2CtraceLast = I2CtraceHead;
+    I2CtraceHead = (I2CtraceHead + 4) & (I2C_TRACE_SIZE - 1);
+}
+
+static u8 I2CaddrDevice(u8 addr)
+{
+    addr >>= 1;
+    if (addr == EXP_I2C_ADDR) return I2C_DEV_EXP;
+    if (addr == CAM_I2C_ADDR) return I2C_DEV_CAM;
+    return I2C_DEV_NONE;
+}
+
+static void I2CreadSeek()
+{
+    // Longest run from I2CregAddr served by plain loads, never past a window
+    // edge or the end of the register page
+    u8 a = I2CregAddr;
+    
+    if (I2Cdev == I2C_DEV_EXP)
+    {
+        if (a < EXP_REG_DATA + I2C_EXP_DATA_SIZE)
+        {
+            I2CreadPtr = (I2Cenc ? I2CexpEncFront : I2CexpFront) + (a - EXP_REG_DATA);
+            I2CreadLeft = EXP_REG_DATA + I2C_EXP_DATA_SIZE - a;
+        }
+        else if ((u8)(a - EXP_REG_TRACE) < I2C_TRACE_WINDOW)
+        {
+            // Trace window, runs end at the window edge so they never cross the ring edge
+            u8 *rec = &I2Creg[I2C_TRACE_BASE + (((I2Creg[EXP_REG_TRACE_PAGE] * I2C_TRACE_WINDOW) + (a - EXP_REG_TRACE)) & (I2C_TRACE_SIZE - 1))];
+            if (I2Cenc)
+            {
+                I2CreadTmp = Encrypt(a, *rec);
+                I2CreadPtr = &I2CreadTmp;
+                I2CreadLeft = 1;
+            }
+            else
+            {
+                I2CreadPtr = rec;
+                I2CreadLeft = EXP_REG_TRACE + I2C_TRACE_WINDOW - a;
+            }
+        }
+        else if (!I2Cenc)
+        {
+            I2CreadPtr = &I2Creg[a];
+            I2CreadLeft = (a < EXP_REG_TRACE) ? (EXP_REG_TRACE - a) : (u8)(0 - a);
+        }
+        else if ((u8)(a - EXP_REG_CAL) < I2C_ENC_CAL_SIZE)
+        {
+            I2CreadPtr = &I2CencCal[a - EXP_REG_CAL];
+            I2CreadLeft = EXP_REG_CAL + I2C_ENC_CAL_SIZE - a;
+        }
+        else if (a >= EXP_REG_ID)
+        {
+            I2CreadPtr = &I2CencID[a - EXP_REG_ID];
+            I2CreadLeft = (u8)(0 - a);
+        }
+        else
+        {
+            // Registers without an encrypted copy are rarely read
+            I2CreadTmp = Encrypt(a, I2Creg[a]);
+            I2CreadPtr = &I2CreadTmp;
+            I2CreadLeft = 1;
+        }
+    }
+    else if (I2Cdev == I2C_DEV_CAM)
+    {
+        if ((u8)(a - CAM_REG_DATA) < I2C_CAM_DATA_SIZE)
+        {
+            I2CreadPtr = I2CcamFront + (a - CAM_REG_DATA);
+            I2CreadLeft = CAM_REG_DATA + I2C_CAM_DATA_SIZE - a;
+        }
+        else if (a >= (u8)(I2C_TRACE_BASE - 256))
+        {
+            // Given over to the trace
+            I2CreadTmp = 0x00;
+            I2CreadPtr = &I2CreadTmp;
+            I2CreadLeft = 1;
+        }
+        else
+        {
+            I2CreadPtr = &I2Creg[a + 256];
+            I2CreadLeft = (a < CAM_REG_DATA) ? (CAM_REG_DATA - a) : (u8)(I2C_TRACE_BASE - 256 - a);
+        }
+    }
+    else
+    {
+        I2CreadTmp = 0xFF;
+        I2CreadPtr = &I2CreadTmp;
+        I2CreadLeft = 1;
+    }
+}
+
+static void I2CreadNext()
+{
+    // Runs after the clock is released, the host is busy with the byte just loaded
+    I2CregAddr++;
+    if (--I2CreadLeft) I2CreadPtr++;
+    else I2CreadSeek();
 }
 
 void I2CslaveHandle()
 {
-    u8 enc = ExpIsEncEnabled();
-        
-    if (SSP1STATbits.P) 
+    u8 status = SSP1STAT & 0b00111100;
+    u8 data;
+    u8 enc;
+    
+    // Read data is the most frequent event and the only one the host waits on
+    // for every byte: the buffer is loaded before anything else is checked
+    if ((status == READ_DAT_ACK) && !SSP1CON2bits.ACKSTAT)
     {
-        I2Caddr = 0;
-        I2CaddrSet = 0;
+        SSP1BUF = *I2CreadPtr;
+        I2CslaveRelease();
+        I2CtraceBytes++;
+        I2CreadNext();
+        return;
+    }
+    
+    // A stop serviced after the next start has no byte and is not a read
+    if (SSP1STATbits.P || !(SSP1STATbits.BF || SSP1STATbits.R_nW)) 
+    {
+        I2Cdev = I2C_DEV_NONE;
         I2CregAddrSet = 0;
         
+        // A read NACKed by the host may be serviced apart from its stop, only the first ends the record
+        if (I2CtraceOpen)
+        {
+            I2CtraceOpen = 0;
+            I2CtraceRecord(I2C_TRACE_STOP, I2CtraceBytes);
+        }
+        
+        // The host has the report, the next one can be sampled
+        if (I2Cserving)
+        {
+            I2Cserving = 0;
+            I2Cconsumed = 1;
+        }
+        
         // Clear pending overflow
-        u8 dummy;
-        if (SSP1STATbits.BF) dummy = SSP1BUF;
+        if (SSP1STATbits.BF) data = SSP1BUF;
         SSP1CON1bits.SSPOV = 0;
+        return;
     }
-    else
+    
+    switch (status)
     {
-        u8 I2Cdata;
-        I2Cstatus = (SSP1STAT & 0b00111100) | (SSP1CON2 & 0b01000000);
-        
-        // Accept write requests only if desired addresses match
-        if (!I2CaddrSet || (I2Caddr == EXP_I2C_ADDR) || (I2Caddr == CAM_I2C_ADDR))
-        {
-            // Store received byte (not reading will cause NACK)
-            if (SSP1STATbits.BF) I2Cdata = SSP1BUF;
+        case READ_ADDR_ACK:
+            data = SSP1BUF;
+            I2Cdev = I2CaddrDevice(data);
+            I2Cactive = 1;
             SSP1CON1bits.SSPOV = 0;
             
-            switch (I2Cstatus)
+            // Serve the latest published report for the whole read
+            if (I2Cdev == I2C_DEV_EXP)
             {
-                case WRITE_ADDR_ACK: 
-                    I2Caddr = I2Cdata >> 1;
-                    I2CaddrSet = 1;
-                    break;
-                  
-                case WRITE_DAT_ACK:
-                    if(I2CregAddrSet)
-                    {   
-                        if (I2Caddr == EXP_I2C_ADDR)
-                        {
-                            // Send data to expansion controller emulator to check for commands
-                            ExpCmdRcv(I2Cdata, I2CregAddr);
-                            if (enc) I2Creg[I2CregAddr] = Decrypt(I2CregAddr, I2Cdata);
-                            else I2Creg[I2CregAddr] = I2Cdata;
-                        }
-                        else if (I2Caddr == CAM_I2C_ADDR)
-                        {
-                            // Send data to camera emulator to check for commands
-                            CamCmdRcv(I2Cdata, I2CregAddr);
-                            I2Creg[I2CregAddr + 256] = I2Cdata;
-                        }
-                
-                        I2CregAddr++;
-                    }
-                    else
-                    {   
-                        I2CregAddr = I2Cdata;
-                        I2CregAddrSet = 1;
-                    }
-                    break;
-                    
-                default:
-                    break;
+                I2CreportFlip(WIN_EXP);
+                ExpUpdateButtons();
             }
-        }
+            else if (I2Cdev == I2C_DEV_CAM) I2CreportFlip(WIN_CAM);
+            
+            I2CreadSeek();
+            SSP1BUF = *I2CreadPtr;
+            I2CslaveRelease();
+            
+            // Timestamp host polls for PollTask()
+            if ((I2Cdev == I2C_DEV_EXP) && (I2CregAddr < EXP_REG_DATA + I2C_EXP_DATA_SIZE))
+            {
+                I2CpollTime = InputGetTimeISR();
+                I2CpollAge = I2CpollTime - I2CexpTime[I2Cfront[WIN_EXP]];
+                I2CpollCount++;
+                I2Cserving = 1;
+            }
+            else if ((I2Cdev == I2C_DEV_CAM) && ((u8)(I2CregAddr - CAM_REG_DATA) < I2C_CAM_DATA_SIZE)) I2Cserving = 1;
+            
+            I2CtraceRecord(data, I2CregAddr);
+            I2CtraceBytes = 1;
+            I2CtraceOpen = 1;
+            I2CreadNext();
+            return;
             
-        // Respond to all read requests
-        switch (I2Cstatus)
-        { 
-            case READ_ADDR_ACK: 
-                I2Caddr = I2Cdata >> 1;
+        case WRITE_ADDR_ACK:
+            data = SSP1BUF;
+            I2Cdev = I2CaddrDevice(data);
+            I2Cactive = 1;
+            SSP1CON1bits.SSPOV = 0;
+            I2CslaveRelease();
+            
+            // The register follows in the first data byte
+            I2CtraceRecord(data, I2C_TRACE_EMPTY);
+            I2CtraceBytes = 0;
+            I2CtraceOpen = 1;
+            return;
             
-            case READ_DAT_ACK:
-                if (I2Caddr == EXP_I2C_ADDR)
+        case WRITE_DAT_ACK:
+            // Bytes for other devices are left unread so the next one is NACKed
+            if (I2Cdev == I2C_DEV_NONE) break;
+            
+            data = SSP1BUF;
+            SSP1CON1bits.SSPOV = 0;
+            I2CslaveRelease();
+            
+            // The clock runs again, the next byte is 9 bit times away
+            if (!I2CregAddrSet)
+            {
+                I2CregAddr = data;
+                I2CregAddrSet = 1;
+                if (I2Ctracing) I2Creg[I2C_TRACE_BASE + I2CtraceLast + 1] = data;
+                return;
+            }
+            
+            I2CtraceBytes++;
+            
+            // Read-only registers keep what the firmware publishes
+            if (I2Clocked[I2Cdev][I2CregAddr >> 3] & I2Cbit[I2CregAddr & 0x07])
+            {
+                I2CregAddr++;
+                return;
+            }
+            
+            if (I2Cdev == I2C_DEV_EXP)
+            {
+                // Only registers with a command behind them reach the emulator
+                enc = I2Cenc;
+                if (I2Chooks[I2C_DEV_EXP][I2CregAddr >> 3] & I2Cbit[I2CregAddr & 0x07]) ExpCmdRcv(data, I2CregAddr);
+                if (enc)
                 {
-                    if (enc) SSP1BUF = Encrypt(I2CregAddr, I2Creg[I2CregAddr]);
-                    else SSP1BUF = I2Creg[I2CregAddr];  
+                    // The received byte is already the encrypted copy
+                    u8 *encReg = I2CencAddr(I2CregAddr);
+                    if (encReg) *encReg = data;
+                    I2Creg[I2CregAddr] = Decrypt(I2CregAddr, data);
                 }
-                else if (I2Caddr == CAM_I2C_ADDR) SSP1BUF = I2Creg[I2CregAddr + 256];
-                else SSP1BUF = 0xFF;
-                    
-                I2CregAddr++;
-                break;
-                
-            default:
-                break;
-        }
+                else I2Creg[I2CregAddr] = data;
+            }
+            else if (I2CregAddr < (u8)(I2C_TRACE_BASE - 256))
+            {
+                if (I2Chooks[I2C_DEV_CAM][I2CregAddr >> 3] & I2Cbit[I2CregAddr & 0x07]) CamCmdRcv(data, I2CregAddr);
+                I2Creg[I2CregAddr + 256] = data;
+            }
+            
+            I2CregAddr++;
+            return;
+            
+        default:
+            // Host NACK ends a read, nothing more is loaded
+            break;
     }
+    
+    // Only byte events hold the clock
+    I2CslaveRelease();
 }
 
 // - - - - - - - - - - //
@@ -177,15 +706,44 @@ void I2CslaveHandle()
 void SPImasterInit(const u32 clk, const u8 CKP, const u8 CKE, const u8 SMP)
 {
     SSP2CON1bits.SSPEN = 0;
-    SSP2CON1 = 0b00001010;                  // SPI master mode with custom clock
+    SSP2CON1 = 0b00000000;                  // SPI master mode
     SSP2CON3 = 0b00010000;                  // Buffer overwrite enabled
-    SSP2ADD = (_XTAL_FREQ / (4 * clk)) - 1; // Set CLK speed
     SSP2CON1bits.CKP = CKP & 0x01;          // CLK polarity (0 = idle low, 1 = idle high)
     SSP2STATbits.CKE = CKE & 0x01;          // SDO transmission edge (0 = idle-to-active CLK, 1 = active-to-idle CLK)
     SSP2STATbits.SMP = SMP & 0x01;          // SDI sampling time (0 = middle, 1 = end)
+    
+    SPIclk = clk;
+    SPIupdateClock();
+    
     SSP2CON1bits.SSPEN = 1;
 }
 
+void SPIupdateClock()
+{
+    // System clocks per SPI clock, rounded up so the requested rate is never exceeded
+    u32 div = (ClockGetFreq() + SPIclk - 1) / SPIclk;
+    
+    if (div <= 4)
+    {
+        // FOSC / 4, the fastest setting
+        div = 4;
+        SSP2CON1bits.SSPM = 0b0000;
+    }
+    else
+    {
+        // FOSC / (4 * (SSP2ADD + 1)), SSP2ADD below 3 is not supported
+        div = (div + 3) >> 2;
+        if (div < 4) div = 4;
+        if (div > 256) div = 256;
+        SSP2ADD = div - 1;
+        SSP2CON1bits.SSPM = 0b1010;
+        div <<= 2;
+    }
+    
+    // A byte takes 2 * div instruction cycles at any system clock, each poll takes several
+    SPItimeout = div;       // so div polls allow at least two byte times
+}
+
 void SPIoff()
 {
     SSP2CON1bits.SSPEN = 0;
@@ -199,9 +757,9 @@ u8 SPIisEnabled()
 u8 SPIwait()
 {
     // Wait until buffer is full
-    u8 timeout = 0;
-    while (!SSP2STATbits.BF && (timeout < 255)) timeout++;
-    if (timeout < 255) return 0;
+    u16 timeout = SPItimeout;
+    while (!SSP2STATbits.BF && timeout) timeout--;
+    if (timeout) return 0;
     return 1;
 }
 
@@ -12,6 +12,25 @@
 #define READ_ADDR_ACK   0b00001100
 #define READ_DAT_ACK    0b00101100
 
+// Report windows served from banked copies instead of I2Creg
+#define I2C_EXP_DATA_SIZE   8       // EXP_REG_DATA to EXP_REG_DATA + 7
+#define I2C_CAM_DATA_SIZE   36      // CAM_REG_DATA to CAM_REG_DATA + 35
+#define I2C_BANKS           3       // Served, published and being written
+
+// Windows kept pre-encrypted while encryption is on
+#define I2C_ENC_CAL_SIZE    32      // EXP_REG_CAL to EXP_REG_CAL + 31
+#define I2C_ENC_ID_SIZE     6       // EXP_REG_ID to EXP_REG_ID + 5
+
+// Transaction trace, a ring of 4 byte records in the unused top of the camera
+// register page. A start record holds the address byte as sent (R/W in bit 0),
+// the register and the input time MSB first. A stop record holds
+// I2C_TRACE_STOP, the data bytes since the start and the input time.
+#define I2C_TRACE_BASE      0x180   // Ring start in I2Creg, camera registers 0x80 and up
+#define I2C_TRACE_SIZE      128     // Ring bytes, 32 records
+#define I2C_TRACE_WINDOW    16      // Ring bytes shown per trace page (EXP_REG_TRACE)
+#define I2C_TRACE_STOP      0x00    // First byte of a stop record
+#define I2C_TRACE_EMPTY     0xFF    // Fill of records not yet written
+
 void I2CslaveInit(const u8 addr1, const u8 addr2);
 
 void I2Coff();
@@ -20,18 +39,48 @@ u8 I2CisEnabled();
 
 u8 I2CslaveRead(u16 addr);
 
+void I2CslaveHook(u16 addr);
+
+void I2CslaveLock(u16 addr, u8 length);
+
 void I2CslaveReadMulti(u16 addr, u8 *buf, u8 length);
 
 void I2CslaveWrite(u16 addr, u8 data);
 
 void I2CslaveWriteMulti(u16 addr, u8 *buf, u8 length);
 
+void I2CreportWrite(u16 addr, u8 *buf, u8 length);
+
+void I2CreportPublish(u16 time);
+
+void I2CreportSkip(u16 addr);
+
+void I2CreportCounts(u32 *writes, u32 *skips);
+
+void I2CreportPatch(u8 addr, u8 data, u8 mask);
+
+void I2CencEnable(u8 en);
+
+u8 I2CwasActive();
+
+u8 I2CwasConsumed();
+
+u8 I2CconsumedPending();
+
+u8 I2CpollGet(u16 *time, u16 *age);
+
+void I2CtraceRun();
+
+void I2CtraceFreeze();
+
 void I2CslaveRelease();
 
 void I2CslaveHandle();
 
 void SPImasterInit(const u32 clk, const u8 CKP, const u8 CKE, const u8 SMP);
 
+void SPIupdateClock();
+
 void SPIoff();
 
 u8 SPIisEnabled();
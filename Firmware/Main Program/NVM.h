@@ -21,6 +21,18 @@
 #define EE_REG_INVERT2  0x0B
 #define EE_REG_CONFIG   0x0C
 #define EE_REG_IR_SENS  0x0D
+#define EE_REG_ADC_FLT  0x0E
+#define EE_REG_LX_CTR   0x0F
+#define EE_REG_LY_CTR   0x10
+#define EE_REG_RX_CTR   0x11
+#define EE_REG_RY_CTR   0x12
+#define EE_REG_CURVE    0x13
+#define EE_REG_KNOT1    0x14
+#define EE_REG_KNOT2    0x15
+#define EE_REG_KNOT3    0x16
+#define EE_REG_IMU_CFG  0x17
+#define EE_REG_CLK_CFG  0x18
+#define EE_REG_POLL_CFG 0x19
 
 void NVMunlock();
 
@@ -16,8 +16,12 @@ Cursor cur;
 u8 camMode;
 u8 camEn;
 
+#define CAM_STEP_TICKS  ((u16)(INPUT_TIME_RATE / CAM_STEP_RATE))
+
 u32 timeoutCount;
 u8 cursorIdle;
+u8 blobsIdle;       // Mode the idle cursor report was published in, 0 if it was not
+u16 stepTime;       // Input time of the last cursor step
 
 u8 sensitivity;
 
@@ -28,14 +32,19 @@ void CamInit()
     
     if (!camMode) camMode = CAM_BASIC;
     
+    I2CslaveHook(CAM_REG_MODE + 256);
+    
     timeoutCount = 0;
     cursorIdle = 1;
+    blobsIdle = 0;
+    stepTime = InputGetTime();
     camEn = 1;
 }
 
 void CamOff()
 {
     cursorIdle = 1;
+    blobsIdle = 0;
     camEn = 0;
 }
 
@@ -62,16 +71,32 @@ void CamUpdateCursor()
 {
     s16 joyX;
     s16 joyY;
+    u8 x = axes.RX;
+    u8 y = axes.RY;
+    u16 now = InputGetTime();
+    u8 steps = 0;
     
-    if ((((s16)axes.RX - 128)*((s16)axes.RX - 128) + ((s16)axes.RY - 128)*((s16)axes.RY - 128) < ((u16)cal.deadzones[DZ_R]*(u16)cal.deadzones[DZ_R])) || !cal.enable[EN_JOY_R])
+    // The cursor moves at a fixed step rate, whatever the loop rate and core clock
+    while ((u16)(now - stepTime) >= CAM_STEP_TICKS)
+    {
+        stepTime += CAM_STEP_TICKS;
+        if (++steps == CAM_STEP_MAX)
+        {
+            stepTime = now;
+            break;
+        }
+    }
+    if (!steps) return;
+    
+    if (!cal.enable[EN_JOY_R] || !ExpDeadzone(DZ_R, &x, &y))
     {
         joyX = 0;
         joyY = 0;
     }
     else
     {
-        joyX = 128 - LUT[axes.RX + LUT_RX];
-        joyY = 128 - LUT[axes.RY + LUT_RY];
+        joyX = 128 - LUT[x + LUT_RX];
+        joyY = 128 - LUT[y + LUT_RY];
     }
     
     // Reset timer if joystick is not centered
@@ -86,8 +111,8 @@ void CamUpdateCursor()
         s16 partialX = (joyX * sensitivity) / 256;
         s16 partialY = (joyY * sensitivity) / 256;
         
-        cur.X += partialX;
-        cur.Y += partialY;
+        cur.X += partialX * steps;
+        cur.Y += partialY * steps;
         
         // Set X boundaries
         if (cur.X < CAM_OFFSET) cur.X = CAM_OFFSET;
@@ -97,7 +122,7 @@ void CamUpdateCursor()
         if (cur.Y < 0) cur.Y = 0;
         else if (cur.Y > (0x3FF * 8)) cur.Y = 0x3FF * 8;
         
-        timeoutCount++;
+        timeoutCount += steps;
     }
     
     if (timeoutCount > CAM_TIMEOUT)
@@ -111,6 +136,14 @@ void CamUpdateBlobs()
 {
     // { X1, Y1, X2, Y2 }
     u16 pos[4];
+    
+    // An idle cursor reports the same blobs every time, once per mode is enough
+    if (cursorIdle && (blobsIdle == camMode))
+    {
+        if (camEn) I2CreportSkip(CAM_REG_DATA + 256);
+        return;
+    }
+    blobsIdle = cursorIdle ? camMode : 0;
 
     if (cursorIdle)
     {
@@ -143,7 +176,7 @@ void CamUpdateBlobs()
             buf[8] = 0xFF;
             buf[9] = 0xFF;
             
-            I2CslaveWriteMulti(CAM_REG_DATA + 256, buf, 10);
+            I2CreportWrite(CAM_REG_DATA + 256, buf, 10);
             break;
             
         case CAM_EXTENDED:
@@ -163,7 +196,7 @@ void CamUpdateBlobs()
             buf[10] = 0xFF;
             buf[11] = 0xF0;
             
-            I2CslaveWriteMulti(CAM_REG_DATA + 256, buf, 12);
+            I2CreportWrite(CAM_REG_DATA + 256, buf, 12);
             break;
             
         case CAM_FULL:
@@ -207,7 +240,7 @@ void CamUpdateBlobs()
             buf[34] = 0;
             buf[35] = 0xFF;
             
-            I2CslaveWriteMulti(CAM_REG_DATA + 256, buf, 36);
+            I2CreportWrite(CAM_REG_DATA + 256, buf, 36);
             break;
         
         default:
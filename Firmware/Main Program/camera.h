@@ -29,7 +29,11 @@
 #define CAM_X_CENTER    525
 #define CAM_Y_CENTER    310
 
-// Cycles required for cursor idle timeout
+// Cursor steps per second, and steps a late update may catch up on
+#define CAM_STEP_RATE   200
+#define CAM_STEP_MAX    4
+
+// Steps required for cursor idle timeout
 #define CAM_TIMEOUT     150
 
 typedef struct
@@ -0,0 +1,82 @@
+/*
+ * File:   clock.c
+ * Author: Jackson Snowden
+ */
+
+#include <xc.h>
+#include "config.h"
+#include "input.h"
+#include "MSSP.h"
+#include "clock.h"
+
+#define CLK_IDLE_TICKS  ((u16)(INPUT_TIME_RATE / 1000 * CLK_IDLE_MS))
+
+u32 clkFreq = CLK_HFINTOSC;     // Active system clock in Hz
+u8 clkNdiv = CLK_32MHZ;         // Active NDIV setting
+
+u8 clkPolicy = CLK_POLICY_DEFAULT;
+u16 clkBusTime;                 // Input time of the last bus activity seen
+
+void ClockSet(u8 ndiv)
+{
+    if (ndiv > CLK_8MHZ) ndiv = CLK_8MHZ;
+    
+    OSCCON1bits.NDIV = ndiv;
+    clkNdiv = ndiv;
+    clkFreq = CLK_HFINTOSC >> ndiv;
+    
+    // Keep the SPI clock at its requested rate
+    if (SPIisEnabled()) SPIupdateClock();
+}
+
+void ClockSetPolicy(u8 policy)
+{
+    if (policy >= CLK_POLICY_COUNT) policy = CLK_POLICY_DEFAULT;
+    clkPolicy = policy;
+    
+    // The idle timeout starts over, a host is expected after a mode change
+    clkBusTime = InputGetTime();
+}
+
+void ClockTask()
+{
+    u8 ndiv;
+    
+    switch (clkPolicy)
+    {
+        case CLK_POLICY_32MHZ:
+            ndiv = CLK_32MHZ;
+            break;
+            
+        case CLK_POLICY_8MHZ:
+            ndiv = CLK_8MHZ;
+            break;
+            
+        default:
+            // Boost on any transfer, drop back after CLK_IDLE_MS without one
+            if (I2CwasActive())
+            {
+                clkBusTime = InputGetTime();
+                ndiv = CLK_32MHZ;
+            }
+            else if ((u16)(InputGetTime() - clkBusTime) >= CLK_IDLE_TICKS) ndiv = CLK_8MHZ;
+            else ndiv = clkNdiv;
+            break;
+    }
+    
+    if (ndiv != clkNdiv) ClockSet(ndiv);
+}
+
+void ClockIdle()
+{
+    // Idle mode halts the core only, timers, ADC and MSSP keep running and any
+    // enabled interrupt wakes it. Wakes with interrupts off as well, the
+    // caller's checks and the SLEEP instruction cannot miss one.
+    CPUDOZEbits.IDLEN = 1;
+    SLEEP();
+}
+
+u32 ClockGetFreq()
+{
+    return clkFreq;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+/* 
+ * File:   clock.h  
+ * Author: Jackson Snowden
+ */
+
+#ifndef _CLOCK_H_
+#define	_CLOCK_H_
+
+// HFINTOSC frequency (RSTOSC = HFINT32), system clock is HFINTOSC / 2^NDIV
+#define CLK_HFINTOSC    32000000
+
+// NDIV settings
+#define CLK_32MHZ       0
+#define CLK_16MHZ       1
+#define CLK_8MHZ        2
+
+// Clock policies while the expansion is connected (EXP_REG_CLK_CFG)
+#define CLK_POLICY_32MHZ    0   // Fixed 32 MHz
+#define CLK_POLICY_8MHZ     1   // Fixed 8 MHz
+#define CLK_POLICY_ADAPTIVE 2   // 32 MHz while the host is on the bus, 8 MHz once it goes quiet
+#define CLK_POLICY_COUNT    3
+#define CLK_POLICY_DEFAULT  CLK_POLICY_ADAPTIVE
+
+// Bus silence before the adaptive policy drops to 8 MHz
+#define CLK_IDLE_MS     100
+
+void ClockSet(u8 ndiv);
+
+void ClockSetPolicy(u8 policy);
+
+void ClockTask();
+
+void ClockIdle();
+
+u32 ClockGetFreq();
+
+#endif  /* _CLOCK_H_ */
\ No newline at end of file
@@ -8,12 +8,23 @@
 
 #define _XTAL_FREQ  8000000
 
-#define u8  unsigned char
-#define u16 unsigned int
-#define u32 unsigned long
-#define s8  signed char
-#define s16 signed int
-#define s32 signed long
+// Timers run on MFINTOSC so their rates do not follow the core clock
+#define MFINTOSC_FREQ   500000
+
+// Stage profiler in the custom registers (prof.h), release builds leave it out
+#ifndef PROF_EN
+#define PROF_EN     0
+#endif
+
+#include <stdint.h>
+
+// Exact-width types so the simulator build keeps PIC integer widths
+#define u8  uint8_t
+#define u16 uint16_t
+#define u32 uint32_t
+#define s8  int8_t
+#define s16 int16_t
+#define s32 int32_t
 
 #define MODE_CLASSIC    0xA
 #define MODE_NUNCHUK    0xB
@@ -12,6 +12,10 @@
 #include "NVM.h"
 #include "IMU.h"
 #include "camera.h"
+#include "ADC.h"
+#include "clock.h"
+#include "poll.h"
+#include "prof.h"
 #include "expansion.h"
 
 // Extension controller IDs recognized by Wii
@@ -57,8 +61,20 @@ const u8 calDataNunchuk[32] =
 Calibration cal;
 Axis axesMapped;
 
-// Look-up-table for all possible joystick inputs (256 per axis)
-u8 LUT[1024];
+// Response curve knots at 1/4, 1/2 and 3/4 deflection (out of 128)
+const u8 curveKnots[3][3] =
+{
+    { 32, 64, 96 },             // Linear
+    { 8, 32, 72 },              // Exponential, t^2
+    { 20, 64, 108 }             // S-curve, 3t^2 - 2t^3
+};
+
+// Accelerometer mapping, report = offset + ((accel * scale) >> 8), negative scale inverts
+s16 xlScale[3];
+u16 xlOffset[3];
+
+// Look-up-table of report values for all possible axis inputs (256 per axis)
+u8 LUT[LUT_SIZE];
 
 u8 expMode;     // Expansion controller mode
 u8 expEn;       // Expansion controller enable
@@ -68,53 +84,310 @@ u8 encEn;       // Input/output encryption enable
 u8 cfgEn;       // Configuration mode enable
 u8 fullModeEn;  // Full reporting mode enable
 
-static u32 Map(u32 x, u32 inMin, u32 inMax, u32 outMin, u32 outMax)
+// Axis tables, parameters each one was built with and the ones wanted
+LUTparams lutBuilt[LUT_AXES];
+LUTparams lutTarget[LUT_AXES];
+u8 lutValid;                // Tables matching lutBuilt, one bit per axis
+u8 lutPending;              // Tables waiting for a rebuild, one bit per axis
+
+// Table rebuild in progress
+u8 lutJob = LUT_IDLE;       // Axis being built
+u16 lutPos;                 // Next input value
+u8 lutVal;                  // Input stretched to 0-255, center at 128
+u16 lutAcc;                 // Remainder of the stretch
+u8 lutCur;                  // Curved value the output has been scaled for
+u8 lutOut;                  // Output above the range minimum
+s16 lutRem;                 // Remainder of the output scaling
+
+// Scaled radial deadzone gain for each stick radius, in 256ths
+u8 dzGain[2][DZ_RADIUS];
+u8 dzBuilt[2];              // Deadzone each gain table was built with
+u8 dzValid;                 // Gain tables matching dzBuilt, one bit per stick
+u8 dzPending;               // Gain tables waiting for a rebuild, one bit per stick
+u8 dzJob = DZ_IDLE;         // Stick being built
+u8 dzPos;                   // Next radius
+
+// Squares of stick distances, one past DZ_RADIUS for the root correction
+const u16 dzSquare[DZ_RADIUS + 1] =
+{
+        0,     1,     4,     9,    16,    25,    36,    49,    64,    81,   100,   121,   144,   169,   196,   225,
+      256,   289,   324,   361,   400,   441,   484,   529,   576,   625,   676,   729,   784,   841,   900,   961,
+     1024,  1089,  1156,  1225,  1296,  1369,  1444,  1521,  1600,  1681,  1764,  1849,  1936,  2025,  2116,  2209,
+     2304,  2401,  2500,  2601,  2704,  2809,  2916,  3025,  3136,  3249,  3364,  3481,  3600,  3721,  3844,  3969,
+     4096,  4225,  4356,  4489,  4624,  4761,  4900,  5041,  5184,  5329,  5476,  5625,  5776,  5929,  6084,  6241,
+     6400,  6561,  6724,  6889,  7056,  7225,  7396,  7569,  7744,  7921,  8100,  8281,  8464,  8649,  8836,  9025,
+     9216,  9409,  9604,  9801, 10000, 10201, 10404, 10609, 10816, 11025, 11236, 11449, 11664, 11881, 12100, 12321,
+    12544, 12769, 12996, 13225, 13456, 13689, 13924, 14161, 14400, 14641, 14884, 15129, 15376, 15625, 15876, 16129,
+    16384
+};
+
+// Square roots of squared radii, rounded down: below DZ_FINE in steps of 4,
+// above in steps of 64. A step never spans more than one whole radius, so one
+// compare against dzSquare finishes the root.
+const u8 dzRootFine[DZ_FINE >> 2] =
+{
+      0,   2,   2,   3,   4,   4,   4,   5,   5,   6,   6,   6,   6,   7,   7,   7,
+      8,   8,   8,   8,   8,   9,   9,   9,   9,  10,  10,  10,  10,  10,  10,  11,
+     11,  11,  11,  11,  12,  12,  12,  12,  12,  12,  12,  13,  13,  13,  13,  13,
+     13,  14,  14,  14,  14,  14,  14,  14,  14,  15,  15,  15,  15,  15,  15,  15,
+     16,  16,  16,  16,  16,  16,  16,  16,  16,  17,  17,  17,  17,  17,  17,  17,
+     17,  18,  18,  18,  18,  18,  18,  18,  18,  18,  18,  19,  19,  19,  19,  19,
+     19,  19,  19,  19,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  21,
+     21,  21,  21,  21,  21,  21,  21,  21,  21,  22,  22,  22,  22,  22,  22,  22,
+     22,  22,  22,  22,  22,  23,  23,  23,  23,  23,  23,  23,  23,  23,  23,  23,
+     24,  24,  24,  24,  24,  24,  24,  24,  24,  24,  24,  24,  24,  25,  25,  25,
+     25,  25,  25,  25,  25,  25,  25,  25,  25,  26,  26,  26,  26,  26,  26,  26,
+     26,  26,  26,  26,  26,  26,  26,  27,  27,  27,  27,  27,  27,  27,  27,  27,
+     27,  27,  27,  27,  28,  28,  28,  28,  28,  28,  28,  28,  28,  28,  28,  28,
+     28,  28,  28,  29,  29,  29,  29,  29,  29,  29,  29,  29,  29,  29,  29,  29,
+     29,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,
+     30,  31,  31,  31,  31,  31,  31,  31,  31,  31,  31,  31,  31,  31,  31,  31
+};
+const u8 dzRoot[(DZ_RADIUS * DZ_RADIUS - DZ_FINE) >> 6] =
+{
+     32,  32,  33,  34,  35,  36,  37,  38,  39,  40,  40,  41,  42,  43,  43,  44,
+     45,  45,  46,  47,  48,  48,  49,  49,  50,  51,  51,  52,  53,  53,  54,  54,
+     55,  56,  56,  57,  57,  58,  58,  59,  59,  60,  60,  61,  61,  62,  62,  63,
+     64,  64,  64,  65,  65,  66,  66,  67,  67,  68,  68,  69,  69,  70,  70,  71,
+     71,  72,  72,  72,  73,  73,  74,  74,  75,  75,  75,  76,  76,  77,  77,  77,
+     78,  78,  79,  79,  80,  80,  80,  81,  81,  81,  82,  82,  83,  83,  83,  84,
+     84,  85,  85,  85,  86,  86,  86,  87,  87,  88,  88,  88,  89,  89,  89,  90,
+     90,  90,  91,  91,  91,  92,  92,  92,  93,  93,  93,  94,  94,  94,  95,  95,
+     96,  96,  96,  96,  97,  97,  97,  98,  98,  98,  99,  99,  99, 100, 100, 100,
+    101, 101, 101, 102, 102, 102, 103, 103, 103, 104, 104, 104, 104, 105, 105, 105,
+    106, 106, 106, 107, 107, 107, 107, 108, 108, 108, 109, 109, 109, 109, 110, 110,
+    110, 111, 111, 111, 112, 112, 112, 112, 113, 113, 113, 113, 114, 114, 114, 115,
+    115, 115, 115, 116, 116, 116, 117, 117, 117, 117, 118, 118, 118, 118, 119, 119,
+    119, 120, 120, 120, 120, 121, 121, 121, 121, 122, 122, 122, 122, 123, 123, 123,
+    123, 124, 124, 124, 124, 125, 125, 125, 125, 126, 126, 126, 126, 127, 127, 127
+};
+
+static void LUTsetTarget(u16 offset, u8 inMin, u8 center, u8 inMax, u8 curve, u8 invert, u8 outMin, u8 outMax)
+{
+    u8 axis = offset >> 8;
+    u8 mask = 1 << axis;
+    LUTparams *t = &lutTarget[axis];
+    u8 *a = (u8*)t;
+    u8 *b = (u8*)&lutBuilt[axis];
+    const u8 *knots = (curve == CURVE_CUSTOM) ? cal.knots : curveKnots[curve];
+    u8 same = lutValid & mask;
+    u8 i;
+    
+    t->inMin = inMin;
+    t->center = center;
+    t->inMax = inMax;
+    t->knots[0] = knots[0];
+    t->knots[1] = knots[1];
+    t->knots[2] = knots[2];
+    t->invert = invert;
+    t->outMin = outMin;
+    t->outMax = outMax;
+    
+    // Only rebuild tables whose parameters changed
+    for (i = 0; i < sizeof(LUTparams); i++)
+    {
+        if (a[i] != b[i]) same = 0;
+    }
+    
+    if (same)
+    {
+        lutPending &= ~mask;
+    }
+    else
+    {
+        lutPending |= mask;
+        if (lutJob == axis) lutJob = LUT_IDLE;
+    }
+}
+
+static u8 LUTcurve(LUTparams *p, u8 t)
 {
-    // Map a single value onto a different range
-    return (((x - inMin) * (outMax - outMin)) / (inMax - inMin)) + outMin;
+    u8 seg = t >> 5;
+    u8 lo;
+    u8 hi;
+    
+    // Piecewise linear through the knots, t and the result are 0-128
+    if (seg > 3) return 128;
+    lo = seg ? p->knots[seg - 1] : 0;
+    hi = (seg < 3) ? p->knots[seg] : 128;
+    
+    return lo + ((((u16)(hi - lo)) * (t & 0x1F) + 16) >> 5);
 }
 
-static void LUTinit()
-{   
-    u16 pos;
+static void DZsetTarget(u8 stick)
+{
+    u8 mask = 1 << stick;
+    
+    if ((dzValid & mask) && (dzBuilt[stick] == cal.deadzones[stick]))
+    {
+        dzPending &= ~mask;
+    }
+    else
+    {
+        dzPending |= mask;
+        if (dzJob == stick) dzJob = DZ_IDLE;
+    }
+}
+
+static void DZtask(u16 count)
+{
+    u8 dz;
+    u16 gain;
     
-    for (pos = 0; pos < 256; pos++)
+    while (count--)
     {
-        // Left Joystick X 
-        if (pos < cal.minMax[MIN_LX])
-            LUT[pos + LUT_LX] = 0;
+        if (dzJob == DZ_IDLE)
+        {
+            if (!dzPending) return;
+            
+            dzJob = (dzPending & 0x01) ? DZ_L : DZ_R;
+            dzPending &= ~(1 << dzJob);
+            dzValid &= ~(1 << dzJob);
+            dzBuilt[dzJob] = cal.deadzones[dzJob];
+            dzPos = 0;
+        }
         
-        else if (pos > cal.minMax[MAX_LX])
-            LUT[pos + LUT_LX] = 255;
+        dz = dzBuilt[dzJob];
         
-        else LUT[pos + LUT_LX] = Map(pos, cal.minMax[MIN_LX], cal.minMax[MAX_LX], 0, 255);
+        // Radius dz maps to the center and DZ_RADIUS to itself, zero marks the deadzone.
+        // Each entry covers radii from dzPos up to dzPos + 1 and holds the gain at the middle.
+        if (dzPos < dz) gain = 0;
+        else gain = ((u32)(2 * dzPos + 1 - 2 * dz) << 15) / ((u32)(DZ_RADIUS - dz) * (2 * dzPos + 1));
         
-        // Left Joystick Y  
-        if (pos < cal.minMax[MIN_LY])
-            LUT[pos + LUT_LY] = 0;
+        dzGain[dzJob][dzPos] = (gain > 255) ? 255 : gain;
         
-        else if (pos > cal.minMax[MAX_LY])
-            LUT[pos + LUT_LY] = 255;
+        if (++dzPos == DZ_RADIUS)
+        {
+            dzValid |= 1 << dzJob;
+            dzJob = DZ_IDLE;
+        }
+    }
+}
+
+static void LUTinit()
+{   
+    // Deadzones are the same in every mode
+    DZsetTarget(DZ_L);
+    DZsetTarget(DZ_R);
+    
+    // Queue the tables for the current mode and calibration, LUTtask() builds them
+    switch (expMode)
+    {
+        case MODE_CLASSIC:
+            LUTsetTarget(LUT_LX, cal.minMax[MIN_LX], cal.center[CTR_LX], cal.minMax[MAX_LX], cal.curve[CTR_LX], cal.invert[INV_JOY_LX], calDataClassic[CC_CAL_LX_LOWER], calDataClassic[CC_CAL_LX_UPPER]);
+            LUTsetTarget(LUT_LY, cal.minMax[MIN_LY], cal.center[CTR_LY], cal.minMax[MAX_LY], cal.curve[CTR_LY], cal.invert[INV_JOY_LY], calDataClassic[CC_CAL_LY_LOWER], calDataClassic[CC_CAL_LY_UPPER]);
+            LUTsetTarget(LUT_RX, cal.minMax[MIN_RX], cal.center[CTR_RX], cal.minMax[MAX_RX], cal.curve[CTR_RX], cal.invert[INV_JOY_RX], calDataClassic[CC_CAL_RX_LOWER], calDataClassic[CC_CAL_RX_UPPER]);
+            LUTsetTarget(LUT_RY, cal.minMax[MIN_RY], cal.center[CTR_RY], cal.minMax[MAX_RY], cal.curve[CTR_RY], cal.invert[INV_JOY_RY], calDataClassic[CC_CAL_RY_LOWER], calDataClassic[CC_CAL_RY_UPPER]);
+            LUTsetTarget(LUT_LT, 0, 128, 255, CURVE_LINEAR, cal.invert[INV_TRIG_L], calDataClassic[CC_CAL_LT_LOWER], 255);
+            LUTsetTarget(LUT_RT, 0, 128, 255, CURVE_LINEAR, cal.invert[INV_TRIG_R], calDataClassic[CC_CAL_RT_LOWER], 255);
+            break;
+            
+        case MODE_NUNCHUK:
+            LUTsetTarget(LUT_LX, cal.minMax[MIN_LX], cal.center[CTR_LX], cal.minMax[MAX_LX], cal.curve[CTR_LX], cal.invert[INV_JOY_LX], calDataNunchuk[NK_CAL_SX_LOWER], calDataNunchuk[NK_CAL_SX_UPPER]);
+            LUTsetTarget(LUT_LY, cal.minMax[MIN_LY], cal.center[CTR_LY], cal.minMax[MAX_LY], cal.curve[CTR_LY], cal.invert[INV_JOY_LY], calDataNunchuk[NK_CAL_SY_LOWER], calDataNunchuk[NK_CAL_SY_UPPER]);
+            
+            // Right joystick drives the camera cursor, kept at full scale
+            LUTsetTarget(LUT_RX, cal.minMax[MIN_RX], cal.center[CTR_RX], cal.minMax[MAX_RX], cal.curve[CTR_RX], 0, 0, 255);
+            LUTsetTarget(LUT_RY, cal.minMax[MIN_RY], cal.center[CTR_RY], cal.minMax[MAX_RY], cal.curve[CTR_RY], 0, 0, 255);
+            break;
+            
+        default:
+            break;
+    }
+}
+
+static void LUTtask(u16 count)
+{
+    LUTparams *p;
+    u8 range;
+    u8 span;
+    u16 c;
+    
+    while (count--)
+    {
+        if (lutJob == LUT_IDLE)
+        {
+            if (!lutPending) return;
+            
+            // Start on the lowest pending axis
+            for (lutJob = 0; !(lutPending & (1 << lutJob)); lutJob++);
+            lutPending &= ~(1 << lutJob);
+            lutValid &= ~(1 << lutJob);
+            lutBuilt[lutJob] = lutTarget[lutJob];
+            
+            lutPos = 0;
+            lutVal = 0;
+            lutAcc = 0;
+            lutCur = 0;
+            lutOut = 0;
+            lutRem = 0;
+        }
         
-        else LUT[pos + LUT_LY] = Map(pos, cal.minMax[MIN_LY], cal.minMax[MAX_LY], 0, 255);
+        p = &lutBuilt[lutJob];
+        range = p->outMax - p->outMin;
         
-        // Right Joystick X
-        if (pos < cal.minMax[MIN_RX])
-            LUT[pos + LUT_RX] = 0;
+        // Stretch: minimum to center onto 0-128 and center to maximum onto 128-255,
+        // (pos - start) * rise / span stepped without dividing
+        if (lutPos > p->inMax)
+        {
+            if (lutPos >= p->inMin) lutVal = 255;
+        }
+        else if (lutPos > p->inMin)
+        {
+            if (lutPos <= p->center)
+            {
+                span = p->center - p->inMin;
+                lutAcc += 128;
+            }
+            else
+            {
+                span = p->inMax - p->center;
+                lutAcc += 127;
+            }
+            
+            while (lutAcc >= span)
+            {
+                lutAcc -= span;
+                lutVal++;
+            }
+        }
         
-        else if (pos > cal.minMax[MAX_RX])
-            LUT[pos + LUT_RX] = 255;
+        // Response curve on the deflection from center
+        if (lutVal >= 128) c = 128 + LUTcurve(p, lutVal - 128);
+        else c = 128 - LUTcurve(p, 128 - lutVal);
+        if (c > 255) c = 255;
         
-        else LUT[pos + LUT_RX] = Map(pos, cal.minMax[MIN_RX], cal.minMax[MAX_RX], 0, 255);
+        if (p->invert) c = 255 - c;
         
-        // Right Joystick Y
-        if (pos < cal.minMax[MIN_RY])
-            LUT[pos + LUT_RY] = 0;
+        // Output: c * range / 255, stepped to follow c
+        while (lutCur < c)
+        {
+            lutCur++;
+            lutRem += range;
+            while (lutRem >= 255)
+            {
+                lutRem -= 255;
+                lutOut++;
+            }
+        }
+        while (lutCur > c)
+        {
+            lutCur--;
+            lutRem -= range;
+            while (lutRem < 0)
+            {
+                lutRem += 255;
+                lutOut--;
+            }
+        }
         
-        else if (pos > cal.minMax[MAX_RY])
-            LUT[pos + LUT_RY] = 255;
+        LUT[(lutJob << 8) + lutPos] = p->outMin + lutOut;
         
-        else LUT[pos + LUT_RY] = Map(pos, cal.minMax[MIN_RY], cal.minMax[MAX_RY], 0, 255);
+        if (++lutPos == 256)
+        {
+            lutValid |= 1 << lutJob;
+            lutJob = LUT_IDLE;
+        }
     }
 }
 
@@ -124,10 +397,20 @@ void ExpInit(const u8 *ID)
     DETECT = 0;
     
     // INTOSC = 32 MHz
-    OSCCON1bits.NDIV = 0;
+    ClockSet(CLK_32MHZ);
     
     // Disable encryption
     encEn = 0;
+    I2CencEnable(0);
+    
+    // Registers with commands behind them
+    I2CslaveHook(EXP_REG_SETUP2);
+    I2CslaveHook(EXP_REG_ID + 4);
+    I2CslaveHook(EXP_REG_KEY + 15);
+    I2CslaveHook(EXP_REG_CMD);
+    
+    // Statistics the firmware publishes, the trace page stays writable
+    I2CslaveLock(EXP_REG_POLL_PER, EXP_REG_TRACE_PAGE - EXP_REG_POLL_PER);
 
 	// Set controller IDs
     I2CslaveWriteMulti(EXP_REG_ID, (u8*)ID, 6);
@@ -148,18 +431,20 @@ void ExpInit(const u8 *ID)
             break;
     }
     
-    // Initialize joystick lookup table
+    // Build the axis tables for this mode before reconnecting
     LUTinit();
+    LUTtask(LUT_SIZE);
+    DZtask(2 * DZ_RADIUS);
     
     // Load neutral values into I2C register
     ExpUpdateDefault();
     
-    // INTOSC = 8 MHz
-    OSCCON1bits.NDIV = 2;
-    
     // Controller reconnect
     DETECT = 1;
     
+    // Learn the host cadence again, a new host may poll at another rate
+    PollInit();
+    
     expCmd = 0;
     cfgEn = 0;
     expEn = 1;
@@ -195,7 +480,7 @@ void ExpSetMode(u8 mode)
             ExpCalLoad();
             if (cal.enable[EN_CAM]) I2CslaveInit(EXP_I2C_ADDR, CAM_I2C_ADDR);
             else I2CslaveInit(EXP_I2C_ADDR, 0);
-            if (!IMUisEnabled()) IMUinit(XL_SCALE_2G, G_OFF);
+            if (!IMUisEnabled() && !IMUisStarting()) IMUinit(XL_SCALE_2G, G_OFF);
             ExpInit(nunchukID);
             CamInit();
             ANSELC = 0b01111110;
@@ -207,6 +492,9 @@ void ExpSetMode(u8 mode)
             ExpOff();
             CamOff();
             ANSELC = 0;
+            
+            // Nothing to serve
+            ClockSet(CLK_8MHZ);
             break;
     }    
 }
@@ -217,7 +505,11 @@ void ExpCmdRcv(u8 data, u8 addr)
     {
         // Disable encryption
         case EXP_REG_SETUP2:
-            if (data == 0) encEn = 0;
+            if (data == 0)
+            {
+                encEn = 0;
+                I2CencEnable(0);
+            }
             break;
             
         // Enable full data reporting mode (Classic Controller only)
@@ -269,22 +561,47 @@ u8 ExpCmdExec()
         case CAL_LOAD:
             expCmd = 0;
             ExpCalLoad();
+            LUTinit();
             break;
                                 
         case CAL_STORE:
             expCmd = 0;
             ExpCalStore();
+            LUTinit();
             break;
                                 
         case CAL_DEFAULT:
             expCmd = 0;
             ExpCalStoreDefault();
+            LUTinit();
             break;
             
         case ENC_EN:
             expCmd = 0;
             I2CslaveReadMulti(EXP_REG_KEY, buf, 16);
-            encEn = InitKeys(buf);
+            encEn = 0;
+            I2CencEnable(0);
+            if (InitKeys(buf))
+            {
+                // Pre-encrypted copies are ready before the host reads any
+                I2CencEnable(1);
+                encEn = 1;
+            }
+            break;
+            
+        case PROF_CLR:
+            expCmd = 0;
+            PROF_RESET();
+            break;
+            
+        case TRACE_FREEZE:
+            expCmd = 0;
+            I2CtraceFreeze();
+            break;
+            
+        case TRACE_RUN:
+            expCmd = 0;
+            I2CtraceRun();
             break;
         
         default:
@@ -299,6 +616,23 @@ u8 ExpIsEncEnabled()
     return encEn;
 }
 
+static u8 ExpCalCenter(u8 center, u8 min, u8 max)
+{
+    // Rest position between the limits, otherwise half way (also covers erased EEPROM)
+    if ((center > min) && (center < max)) return center;
+    return ((u16)min + max + 1) >> 1;
+}
+
+static void XLsetMap(u8 axis, u8 zeroH, u8 fullH, u8 shift, u8 invert)
+{
+    u16 zero = ((u16)calDataNunchuk[zeroH] << 2) | ((calDataNunchuk[NK_CAL_A_0G_L] >> shift) & 0x03);
+    u16 full = ((u16)calDataNunchuk[fullH] << 2) | ((calDataNunchuk[NK_CAL_A_1G_L] >> shift) & 0x03);
+    
+    // Accelerometer input is 256 per g, scaled to the span between the 0g and 1g calibration points
+    xlScale[axis] = invert ? (s16)(zero - full) : (s16)(full - zero);
+    xlOffset[axis] = zero;
+}
+
 void ExpCalInit(u8 *buf)
 {
     cal.minMax[MIN_LX] = buf[0];
@@ -323,35 +657,72 @@ void ExpCalInit(u8 *buf)
     cal.invert[INV_XL_Y] = (buf[11] & 0x02) >> 1;
     cal.invert[INV_XL_Z] = (buf[11] & 0x04) >> 2;
     
+    XLsetMap(XL_X, NK_CAL_AX_0G, NK_CAL_AX_1G, 4, cal.invert[INV_XL_X]);
+    XLsetMap(XL_Y, NK_CAL_AY_0G, NK_CAL_AY_1G, 2, cal.invert[INV_XL_Y]);
+    XLsetMap(XL_Z, NK_CAL_AZ_0G, NK_CAL_AZ_1G, 0, cal.invert[INV_XL_Z]);
+    
     cal.enable[EN_JOY_L] =  buf[12] & 0x01;
     cal.enable[EN_JOY_R] = (buf[12] & 0x02) >> 1;
     cal.enable[EN_TRIG] =  (buf[12] & 0x04) >> 2;
     cal.enable[EN_CAM] =   (buf[12] & 0x08) >> 3;
     
     CamSetSensitivity(buf[13]);
+    ADCsetFilter(buf[14]);
+    
+    cal.center[CTR_LX] = ExpCalCenter(buf[15], cal.minMax[MIN_LX], cal.minMax[MAX_LX]);
+    cal.center[CTR_LY] = ExpCalCenter(buf[16], cal.minMax[MIN_LY], cal.minMax[MAX_LY]);
+    cal.center[CTR_RX] = ExpCalCenter(buf[17], cal.minMax[MIN_RX], cal.minMax[MAX_RX]);
+    cal.center[CTR_RY] = ExpCalCenter(buf[18], cal.minMax[MIN_RY], cal.minMax[MAX_RY]);
+    
+    cal.curve[CTR_LX] =  buf[19] & 0x03;
+    cal.curve[CTR_LY] = (buf[19] & 0x0C) >> 2;
+    cal.curve[CTR_RX] = (buf[19] & 0x30) >> 4;
+    cal.curve[CTR_RY] = (buf[19] & 0xC0) >> 6;
+    
+    // Custom knots must rise to at most full deflection, otherwise linear (also covers erased EEPROM)
+    if ((buf[20] <= buf[21]) && (buf[21] <= buf[22]) && (buf[22] <= 128))
+    {
+        cal.knots[0] = buf[20];
+        cal.knots[1] = buf[21];
+        cal.knots[2] = buf[22];
+    }
+    else
+    {
+        cal.knots[0] = curveKnots[CURVE_LINEAR][0];
+        cal.knots[1] = curveKnots[CURVE_LINEAR][1];
+        cal.knots[2] = curveKnots[CURVE_LINEAR][2];
+    }
+    
+    IMUsetProfile(buf[23]);
+    ClockSetPolicy(buf[24]);
+    PollSetMode(buf[25]);
 }
 
 void ExpCalLoad()
 {
-    u8 buf[14];
-    EEread(EE_REG_LX_MIN, buf, 14);                 // Get EEPROM values
-    I2CslaveWriteMulti(EXP_REG_LX_MIN, buf, 14);    // Transfer to I2C register
-    ExpCalInit(buf);                                // Transfer to struct
+    u8 buf[EE_CAL_SIZE];
+    EEread(EE_REG_LX_MIN, buf, EE_CAL_SIZE);                            // Get EEPROM values
+    I2CslaveWriteMulti(EXP_REG_LX_MIN, buf, CAL_SIZE);                  // Transfer to I2C register
+    I2CslaveWriteMulti(EXP_REG_LX_CTR, buf + CAL_SIZE, CAL_EXT_SIZE);
+    ExpCalInit(buf);                                                    // Transfer to struct
 }
 
 void ExpCalStore()
 {
-    u8 buf[14];
-    I2CslaveReadMulti(EXP_REG_LX_MIN, buf, 14);     // Get I2C register values
-    EEwrite(EE_REG_LX_MIN, buf, 14);                // Transfer to EEPROM
-    ExpCalInit(buf);                                // Transfer to struct
+    u8 buf[EE_CAL_SIZE];
+    I2CslaveReadMulti(EXP_REG_LX_MIN, buf, CAL_SIZE);                   // Get I2C register values
+    I2CslaveReadMulti(EXP_REG_LX_CTR, buf + CAL_SIZE, CAL_EXT_SIZE);
+    EEwrite(EE_REG_LX_MIN, buf, EE_CAL_SIZE);                           // Transfer to EEPROM
+    ExpCalInit(buf);                                                    // Transfer to struct
 }
 
 void ExpCalStoreDefault()
 {
-    u8 buf[14];
+    u8 buf[EE_CAL_SIZE];
     
-    // Maximum joystick boundaries, deadzone = 10, joysticks enabled, triggers disabled
+    // Maximum joystick boundaries, deadzone = 10, joysticks enabled, triggers disabled, 4x axis filter,
+    // centers half way between the boundaries, linear curves, accelerometer read directly,
+    // adaptive core clock, reports refreshed every pass
     buf[0] = 0;
     buf[1] = 0;
     buf[2] = 255;
@@ -366,69 +737,117 @@ void ExpCalStoreDefault()
     buf[11] = 0;
     buf[12] = 3;
     buf[13] = 50;
+    buf[14] = ADC_FILTER_DEFAULT;
+    buf[15] = 0;
+    buf[16] = 0;
+    buf[17] = 0;
+    buf[18] = 0;
+    buf[19] = 0;
+    buf[20] = 32;
+    buf[21] = 64;
+    buf[22] = 96;
+    buf[23] = IMU_PROFILE_DIRECT;
+    buf[24] = CLK_POLICY_DEFAULT;
+    buf[25] = POLL_MODE_DEFAULT;
     
-    EEwrite(EE_REG_LX_MIN, buf, 14);
+    EEwrite(EE_REG_LX_MIN, buf, EE_CAL_SIZE);
     ExpCalInit(buf);
 }
 
+u8 ExpDeadzone(u8 stick, u8 *x, u8 *y)
+{
+    u8 cx = cal.center[stick << 1];
+    u8 cy = cal.center[(stick << 1) + 1];
+    u8 dx;
+    u8 dy;
+    u8 r;
+    u16 m;
+    u8 gain;
+    
+    // Distance from the calibrated center on each axis
+    dx = (*x >= cx) ? *x - cx : cx - *x;
+    dy = (*y >= cy) ? *y - cy : cy - *y;
+    if ((dx >= DZ_RADIUS) || (dy >= DZ_RADIUS)) return 1;
+    
+    m = dzSquare[dx] + dzSquare[dy];
+    if (m >= (u16)DZ_RADIUS * DZ_RADIUS) return 1;
+    
+    // Radius from the coarse squared radius, then at most one step up
+    if (m < DZ_FINE) r = dzRootFine[m >> 2];
+    else r = dzRoot[(m - DZ_FINE) >> 6];
+    if (dzSquare[r + 1] <= m) r++;
+    
+    gain = dzGain[stick][r];
+    if (!gain) return 0;
+    
+    // Scale the stick vector so the deadzone edge lands on the center
+    dx = ((u16)dx * gain + 128) >> 8;
+    dy = ((u16)dy * gain + 128) >> 8;
+    
+    *x = (*x >= cx) ? cx + dx : cx - dx;
+    *y = (*y >= cy) ? cy + dy : cy - dy;
+    
+    return 1;
+}
+
+u8 ExpTask()
+{
+    // Continue any table rebuild a little at a time
+    LUTtask(LUT_STEP);
+    DZtask(DZ_STEP);
+    
+    return (lutJob != LUT_IDLE) || lutPending || (dzJob != DZ_IDLE) || dzPending;
+}
+
 void ExpUpdate()
 {
+    u16 state = buttons;
     u8 buf[8];
-    
-    u32 NKcalAXneutral;
-    u32 NKcalAYneutral;
-    u32 NKcalAZneutral;
-    u32 NKcalAXfull;
-    u32 NKcalAYfull;
-    u32 NKcalAZfull;
+    u8 x;
+    u8 y;
     
     switch (expMode)
     {            
         case MODE_CLASSIC:
             // Use neutral position if joystick magnitude is within deadzone or joystick is disabled          
-            if ((((s16)axes.LX - 128)*((s16)axes.LX - 128) + ((s16)axes.LY - 128)*((s16)axes.LY - 128) < ((u16)cal.deadzones[DZ_L]*(u16)cal.deadzones[DZ_L])) || !cal.enable[EN_JOY_L])
+            x = axes.LX;
+            y = axes.LY;
+            if (!cal.enable[EN_JOY_L] || !ExpDeadzone(DZ_L, &x, &y))
             {
                 axesMapped.LX = 0x7F;
                 axesMapped.LY = 0x7F;
             }
             else
             {
-                if (cal.invert[INV_JOY_LX]) axesMapped.LX = Map(255 - LUT[axes.LX + LUT_LX], 0, 255, calDataClassic[CC_CAL_LX_LOWER], calDataClassic[CC_CAL_LX_UPPER]);
-                else axesMapped.LX = Map(LUT[axes.LX + LUT_LX], 0, 255, calDataClassic[CC_CAL_LX_LOWER], calDataClassic[CC_CAL_LX_UPPER]);
-                
-                if (cal.invert[INV_JOY_LY]) axesMapped.LY = Map(255 - LUT[axes.LY + LUT_LY], 0, 255, calDataClassic[CC_CAL_LY_LOWER], calDataClassic[CC_CAL_LY_UPPER]);
-                else axesMapped.LY = Map(LUT[axes.LY + LUT_LY], 0, 255, calDataClassic[CC_CAL_LY_LOWER], calDataClassic[CC_CAL_LY_UPPER]);
+                axesMapped.LX = LUT[x + LUT_LX];
+                axesMapped.LY = LUT[y + LUT_LY];
             }
             
-            if ((((s16)axes.RX - 128)*((s16)axes.RX - 128) + ((s16)axes.RY - 128)*((s16)axes.RY - 128) < ((u16)cal.deadzones[DZ_R]*(u16)cal.deadzones[DZ_R])) || !cal.enable[EN_JOY_R])
+            x = axes.RX;
+            y = axes.RY;
+            if (!cal.enable[EN_JOY_R] || !ExpDeadzone(DZ_R, &x, &y))
             {
                 axesMapped.RX = 0x7F;
                 axesMapped.RY = 0x7F;
             }
             else
             {
-                if (cal.invert[INV_JOY_RX]) axesMapped.RX = Map(255 - LUT[axes.RX + LUT_RX], 0, 255, calDataClassic[CC_CAL_RX_LOWER], calDataClassic[CC_CAL_RX_UPPER]);  
-                else axesMapped.RX = Map(LUT[axes.RX + LUT_RX], 0, 255, calDataClassic[CC_CAL_RX_LOWER], calDataClassic[CC_CAL_RX_UPPER]);
-                
-                if (cal.invert[INV_JOY_RY]) axesMapped.RY = Map(255 - LUT[axes.RY + LUT_RY], 0, 255, calDataClassic[CC_CAL_RY_LOWER], calDataClassic[CC_CAL_RY_UPPER]);  
-                else axesMapped.RY = Map(LUT[axes.RY + LUT_RY], 0, 255, calDataClassic[CC_CAL_RY_LOWER], calDataClassic[CC_CAL_RY_UPPER]); 
+                axesMapped.RX = LUT[x + LUT_RX];
+                axesMapped.RY = LUT[y + LUT_RY];
             }
             
             if (!cal.enable[EN_TRIG])
             {
-                if (!buttons.L) axesMapped.LT = 0xFF;
+                if (!(buttons & BTN_L)) axesMapped.LT = 0xFF;
                 else axesMapped.LT = calDataClassic[CC_CAL_LT_LOWER];
                 
-                if (!buttons.R) axesMapped.RT = 0xFF;
+                if (!(buttons & BTN_R)) axesMapped.RT = 0xFF;
                 else axesMapped.RT = calDataClassic[CC_CAL_RT_LOWER];
             }
             else
             {
-                if (cal.invert[INV_TRIG_L]) axesMapped.LT = Map(255 - axes.LT, 0, 255, calDataClassic[CC_CAL_LT_LOWER], 255);
-                else axesMapped.LT = Map(axes.LT, 0, 255, calDataClassic[CC_CAL_LT_LOWER], 255); 
-                
-                if (cal.invert[INV_TRIG_R]) axesMapped.RT = Map(255 - axes.RT, 0, 255, calDataClassic[CC_CAL_RT_LOWER], 255);
-                else axesMapped.RT = Map(axes.RT, 0, 255, calDataClassic[CC_CAL_RT_LOWER], 255);  
+                axesMapped.LT = LUT[axes.LT + LUT_LT];
+                axesMapped.RT = LUT[axes.RT + LUT_RT];
             }
             
             if (fullModeEn)
@@ -439,25 +858,11 @@ void ExpUpdate()
                 buf[3] = axesMapped.RY;
                 buf[4] = axesMapped.LT;
                 buf[5] = axesMapped.RT;
+                buf[6] = state >> 8;
+                buf[7] = state & 0xFF;
             
-                buf[6] = ((buttons.DR & 1) << 7) |  
-                         ((buttons.DD & 1) << 6) |     
-                         ((buttons.L & 1) << 5) |      
-                         ((buttons.Minus & 1) << 4) |   
-                         ((buttons.Home & 1) << 3) |      
-                         ((buttons.Plus & 1) << 2) |     
-                         ((buttons.R & 1) << 1) | 0x01;  
-    
-                buf[7] = ((buttons.ZL & 1) << 7) |
-                         ((buttons.B & 1) << 6) |
-                         ((buttons.Y & 1) << 5) |
-                         ((buttons.A & 1) << 4) |
-                         ((buttons.X & 1) << 3) |
-                         ((buttons.ZR & 1) << 2) |
-                         ((buttons.DL & 1) << 1) |
-                          (buttons.DU & 1);
-            
-                I2CslaveWriteMulti(EXP_REG_DATA, buf, 8);
+                // ExpUpdateButtons() refreshes the button bytes as the read starts
+                I2CreportWrite(EXP_REG_DATA, buf, 8);
             }
             else
             {
@@ -477,63 +882,36 @@ void ExpUpdate()
                           (axesMapped.RY & 0x1F);           // RY 
                 buf[3] = ((axesMapped.LT << 5) & 0xE0) |    // LT [2:0]
                           (axesMapped.RT & 0x1F);           // RT
+                buf[4] = state >> 8;
+                buf[5] = state & 0xFF;
             
-                buf[4] = ((buttons.DR & 1) << 7) |  
-                         ((buttons.DD & 1) << 6) |     
-                         ((buttons.L & 1) << 5) |      
-                         ((buttons.Minus & 1) << 4) |   
-                         ((buttons.Home & 1) << 3) |      
-                         ((buttons.Plus & 1) << 2) |     
-                         ((buttons.R & 1) << 1) | 0x01;  
-    
-                buf[5] = ((buttons.ZL & 1) << 7) |
-                         ((buttons.B & 1) << 6) |
-                         ((buttons.Y & 1) << 5) |
-                         ((buttons.A & 1) << 4) |
-                         ((buttons.X & 1) << 3) |
-                         ((buttons.ZR & 1) << 2) |
-                         ((buttons.DL & 1) << 1) |
-                          (buttons.DU & 1);
-            
-                I2CslaveWriteMulti(EXP_REG_DATA, buf, 6);
+                // ExpUpdateButtons() refreshes the button bytes as the read starts
+                I2CreportWrite(EXP_REG_DATA, buf, 6);
             }
             break;
             
         case MODE_NUNCHUK:
-            // Initialize accelerometer calibration constants
-            NKcalAXneutral = (calDataNunchuk[NK_CAL_AX_0G] << 2) | ((calDataNunchuk[NK_CAL_A_0G_L] >> 4) & 0x03);
-            NKcalAYneutral = (calDataNunchuk[NK_CAL_AY_0G] << 2) | ((calDataNunchuk[NK_CAL_A_0G_L] >> 2) & 0x03);
-            NKcalAZneutral = (calDataNunchuk[NK_CAL_AZ_0G] << 2) | (calDataNunchuk[NK_CAL_A_0G_L] & 0x03);
-            NKcalAXfull = (calDataNunchuk[NK_CAL_AX_1G] << 2) | ((calDataNunchuk[NK_CAL_A_1G_L] >> 4) & 0x03);
-            NKcalAYfull = (calDataNunchuk[NK_CAL_AY_1G] << 2) | ((calDataNunchuk[NK_CAL_A_1G_L] >> 2) & 0x03);
-            NKcalAZfull = (calDataNunchuk[NK_CAL_AZ_1G] << 2) | (calDataNunchuk[NK_CAL_A_1G_L] & 0x03);
-            
             // Update IR camera cursor
             if (cal.enable[EN_CAM]) CamUpdateCursor();
             
             // Use neutral position if joystick magnitude is within deadzone or joystick is disabled
-            if ((((s16)axes.LX - 128)*((s16)axes.LX - 128) + ((s16)axes.LY - 128)*((s16)axes.LY - 128) < ((u16)cal.deadzones[DZ_L]*(u16)cal.deadzones[DZ_L])) || !cal.enable[EN_JOY_L])
+            x = axes.LX;
+            y = axes.LY;
+            if (!cal.enable[EN_JOY_L] || !ExpDeadzone(DZ_L, &x, &y))
             {
                 axesMapped.LX = 0x7F;
                 axesMapped.LY = 0x7F;
             }
             else
             {
-                if (cal.invert[INV_JOY_LX]) axesMapped.LX = Map(255 - LUT[axes.LX + LUT_LX], 0, 255, calDataNunchuk[NK_CAL_SX_LOWER], calDataNunchuk[NK_CAL_SX_UPPER]);
-                else axesMapped.LX = Map(LUT[axes.LX + LUT_LX], 0, 255, calDataNunchuk[NK_CAL_SX_LOWER], calDataNunchuk[NK_CAL_SX_UPPER]);
-                
-                if (cal.invert[INV_JOY_LY]) axesMapped.LY = Map(255 - LUT[axes.LY + LUT_LY], 0, 255, calDataNunchuk[NK_CAL_SY_LOWER], calDataNunchuk[NK_CAL_SY_UPPER]);
-                else axesMapped.LY = Map(LUT[axes.LY + LUT_LY], 0, 255, calDataNunchuk[NK_CAL_SY_LOWER], calDataNunchuk[NK_CAL_SY_UPPER]);
+                axesMapped.LX = LUT[x + LUT_LX];
+                axesMapped.LY = LUT[y + LUT_LY];
             }
             
-            if (cal.invert[INV_XL_X]) axesMapped.AX = (u16)(((-1)*((s32)axes.AX) * (NKcalAXfull - NKcalAXneutral)) / 256) + NKcalAXneutral;
-            else axesMapped.AX = (u16)(((s32)axes.AX * (NKcalAXfull - NKcalAXneutral)) / 256) + NKcalAXneutral;
-            
-            if (cal.invert[INV_XL_Y]) axesMapped.AY = (u16)(((-1)*((s32)axes.AY) * (NKcalAYfull - NKcalAYneutral)) / 256) + NKcalAYneutral;
-            else axesMapped.AY = (u16)(((s32)axes.AY * (NKcalAYfull - NKcalAYneutral)) / 256) + NKcalAYneutral;
-            
-            if (cal.invert[INV_XL_Z]) axesMapped.AZ = (u16)(((-1)*((s32)axes.AZ) * (NKcalAZfull - NKcalAZneutral)) / 256) + NKcalAZneutral;
-            else axesMapped.AZ = (u16)(((s32)axes.AZ * (NKcalAZfull - NKcalAZneutral)) / 256) + NKcalAZneutral;
+            // Accelerometer scale and offset, set up by ExpCalInit()
+            axesMapped.AX = xlOffset[XL_X] + (u16)(((s32)axes.AX * xlScale[XL_X]) >> 8);
+            axesMapped.AY = xlOffset[XL_Y] + (u16)(((s32)axes.AY * xlScale[XL_Y]) >> 8);
+            axesMapped.AZ = xlOffset[XL_Z] + (u16)(((s32)axes.AZ * xlScale[XL_Z]) >> 8);
             
             buf[0] =   axesMapped.LX;                   // LX
             buf[1] =   axesMapped.LY;                   // LY
@@ -543,10 +921,10 @@ void ExpUpdate()
             buf[5] = ((axesMapped.AZ << 6) & 0xC0) |    // AccelZ [1:0]
                      ((axesMapped.AY << 4) & 0x30) |    // AccelY [1:0]
                      ((axesMapped.AX << 2) & 0x0C) |    // AccelX [1:0]
-                     ((buttons.C & 1) << 1) |
-                      (buttons.Z & 1);
+                     (state & (BTN_C | BTN_Z));         // C and Z
             
-            I2CslaveWriteMulti(EXP_REG_DATA, buf, 6);
+            // ExpUpdateButtons() refreshes C and Z as the read starts
+            I2CreportWrite(EXP_REG_DATA, buf, 6);
             break;
             
         default:
@@ -568,6 +946,39 @@ void ExpUpdate()
     }
 }
 
+void ExpUpdateButtons()
+{
+    u16 state = buttons;
+    
+    // Called from the I2C interrupt as a read of the report starts, so the
+    // host always gets the latest debounced buttons. The published report
+    // already holds them unless they changed since, so this rarely encrypts.
+    if (!expEn) return;
+    
+    switch (expMode)
+    {
+        case MODE_CLASSIC:
+            if (fullModeEn)
+            {
+                I2CreportPatch(EXP_REG_DATA + 6, state >> 8, 0xFF);
+                I2CreportPatch(EXP_REG_DATA + 7, state & 0xFF, 0xFF);
+            }
+            else
+            {
+                I2CreportPatch(EXP_REG_DATA + 4, state >> 8, 0xFF);
+                I2CreportPatch(EXP_REG_DATA + 5, state & 0xFF, 0xFF);
+            }
+            break;
+            
+        case MODE_NUNCHUK:
+            I2CreportPatch(EXP_REG_DATA + 5, state & 0xFF, BTN_C | BTN_Z);
+            break;
+            
+        default:
+            break;
+    }
+}
+
 void ExpUpdateDefault()
 {
     u8 buf[8];
@@ -586,7 +997,7 @@ void ExpUpdateDefault()
                 buf[5] = 0x7F;
                 buf[6] = 0xFF;
                 buf[7] = 0xFF;
-                I2CslaveWriteMulti(EXP_REG_DATA, buf, 8);
+                I2CreportWrite(EXP_REG_DATA, buf, 8);
             }
             else
             {
@@ -596,7 +1007,7 @@ void ExpUpdateDefault()
                 buf[3] = 0x00;
                 buf[4] = 0xFF;
                 buf[5] = 0xFF;
-                I2CslaveWriteMulti(EXP_REG_DATA, buf, 6);
+                I2CreportWrite(EXP_REG_DATA, buf, 6);
             }
             break;
         
@@ -607,10 +1018,12 @@ void ExpUpdateDefault()
             buf[3] = 0x7F;
             buf[4] = 0xB4;
             buf[5] = 0x3F;
-            I2CslaveWriteMulti(EXP_REG_DATA, buf, 6);
+            I2CreportWrite(EXP_REG_DATA, buf, 6);
             break;
         
         default:
             break;
     }   
+    
+    I2CreportPublish(InputGetTime());
 }
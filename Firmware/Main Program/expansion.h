@@ -32,6 +32,7 @@
 #define EXP_REG_INVERT2 0x6B    // Invert active high ( 0 | 0 | 0 | 0 | 0 | AZ | AY | AX )
 #define EXP_REG_CONFIG  0x6C    // Misc. settings ( 0 | 0 | 0 | 0 | IR Camera Enable | Trigger Enable | Right Joystick Enable | Left Joystick Enable )
 #define EXP_REG_IR_SENS 0x6D    // Camera sensitivity
+#define EXP_REG_ADC_FLT 0x6E    // Axis filter depth, 2^n conversions averaged per sample (0 to 4)
 #define EXP_REG_CMD     0x6F    // Command reception from Wii Remote
 #define EXP_REG_LX_RAW  0x70    // Raw LX output
 #define EXP_REG_LY_RAW  0x71    // Raw LY output
@@ -39,8 +40,30 @@
 #define EXP_REG_RY_RAW  0x73    // Raw RY output
 #define EXP_REG_LT_RAW  0x74    // Raw LT output
 #define EXP_REG_RT_RAW  0x75    // Raw RT output
+#define EXP_REG_LX_CTR  0x76    // Left joystick X rest position (outside min/max = half way)
+#define EXP_REG_LY_CTR  0x77    // Left joystick Y rest position
+#define EXP_REG_RX_CTR  0x78    // Right joystick X rest position
+#define EXP_REG_RY_CTR  0x79    // Right joystick Y rest position
+#define EXP_REG_CURVE   0x7A    // Response curves ( RY [1:0] | RX [1:0] | LY [1:0] | LX [1:0] ), see CURVE_*
+#define EXP_REG_KNOT1   0x7B    // Custom curve output at 1/4 deflection (0 to 128)
+#define EXP_REG_KNOT2   0x7C    // Custom curve output at 1/2 deflection
+#define EXP_REG_KNOT3   0x7D    // Custom curve output at 3/4 deflection
+#define EXP_REG_IMU_CFG 0x7E    // Accelerometer profile, see IMU_PROFILE_*
+#define EXP_REG_CLK_CFG 0x7F    // Core clock policy, see CLK_POLICY_*
+#define EXP_REG_POLL_CFG 0x80   // Report refresh mode, see POLL_MODE_*
 #define EXP_REG_FW_VER  0x81    // Device firmware version
 #define EXP_REG_CID     0x82    // Custom device ID
+#define EXP_REG_POLL_PER 0x83   // Estimated host poll period in us, MSB first (0x83 to 0x84), 0 until known
+#define EXP_REG_POLL_AGE 0x85   // Sample-to-read age of the last polled report in us, MSB first (0x85 to 0x86)
+#define EXP_REG_PROF    0x87    // Stage profiler, PROF_EN builds only (0x87 to 0xD0), see prof.h
+#define EXP_REG_TRACE_HEAD 0xD1 // Oldest I2C trace record (0 to 31), set when the trace is frozen
+#define EXP_REG_TRACE_PAGE 0xD2 // I2C trace page shown in the window (0 to 7)
+#define EXP_REG_TRACE   0xD3    // I2C trace window, 4 records of the selected page (0xD3 to 0xE2), see MSSP.h
+
+// Calibration registers kept in EEPROM (0x60 through 0x6E, then 0x76 through 0x80)
+#define CAL_SIZE        15
+#define CAL_EXT_SIZE    11
+#define EE_CAL_SIZE     (CAL_SIZE + CAL_EXT_SIZE)
 
 // Classic+ ID
 #define CID 0xCC
@@ -49,19 +72,35 @@
 #define PGM_EN          0x1A    // Enable programming mode
 #define PGM_DIS         0x2A    // Disable programming mode
 #define CAL_LOAD        0x1B	// Load EEPROM data into I2C registers
-#define CAL_STORE       0x1C	// Store data loaded into I2C registers (0x60 through 0x6C)
+#define CAL_STORE       0x1C	// Store data loaded into I2C registers (0x60 through 0x6E, 0x76 through 0x80)
 #define CAL_DEFAULT     0x1D    // Reset settngs in EEPROM
 #define CFG_EN          0x1E    // Enable configuration mode
 #define CFG_DIS         0x2E    // Disable configuration mode
 #define ENC_EN          0x1F    // Enable device encryption
-
-extern u8 LUT[1024];
+#define PROF_CLR        0x20    // Clear profiler statistics (PROF_EN builds)
+#define TRACE_FREEZE    0x21    // Stop the I2C trace so it can be read back
+#define TRACE_RUN       0x22    // Clear the I2C trace and record again
 
 // LUT register positions
 #define LUT_LX  0x000
 #define LUT_LY  0x100
 #define LUT_RX  0x200
 #define LUT_RY  0x300
+#define LUT_LT  0x400
+#define LUT_RT  0x500
+
+#define LUT_SIZE    0x600
+#define LUT_AXES    6
+#define LUT_IDLE    0xFF    // No table being built
+#define LUT_STEP    32      // Table entries built per ExpTask() call
+
+// Deadzone gain tables, the gain is 1 from full deflection outwards
+#define DZ_RADIUS   128
+#define DZ_FINE     1024    // Squared radii below this take their root from the fine table
+#define DZ_IDLE     0xFF    // No gain table being built
+#define DZ_STEP     4       // Gain entries built per ExpTask() call
+
+extern u8 LUT[LUT_SIZE];
 
 // Classic Controller calibration data register positions
 #define CC_CAL_LX_UPPER 0
@@ -95,11 +134,27 @@ typedef struct
     u8 deadzones[2];
     u8 invert[9];
     u8 enable[4];
+    u8 center[4];
+    u8 curve[4];
+    u8 knots[3];
 } 
 Calibration;
 
 extern Calibration cal;
 
+// Parameters an axis table is built from
+typedef struct
+{
+    u8 inMin;
+    u8 center;
+    u8 inMax;
+    u8 knots[3];
+    u8 invert;
+    u8 outMin;
+    u8 outMax;
+}
+LUTparams;
+
 // Calibration struct register positions
 #define MIN_LX  0
 #define MIN_LY  1
@@ -128,6 +183,21 @@ extern Calibration cal;
 #define EN_TRIG     2
 #define EN_CAM      3
 
+#define XL_X        0
+#define XL_Y        1
+#define XL_Z        2
+
+#define CTR_LX      0
+#define CTR_LY      1
+#define CTR_RX      2
+#define CTR_RY      3
+
+// Response curves
+#define CURVE_LINEAR    0
+#define CURVE_EXP       1
+#define CURVE_S         2
+#define CURVE_CUSTOM    3
+
 void ExpInit(const u8 *ID);
 
 void ExpOff();
@@ -150,8 +220,15 @@ void ExpCalStore();
 
 void ExpCalStoreDefault();
 
+// Scaled radial deadzone on raw stick values, returns 0 inside the deadzone
+u8 ExpDeadzone(u8 stick, u8 *x, u8 *y);
+
+u8 ExpTask();
+
 void ExpUpdate();
 
+void ExpUpdateButtons();
+
 void ExpUpdateDefault();
 
 #endif  /* _EXPANSION_H_ */
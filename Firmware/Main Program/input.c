@@ -11,51 +11,195 @@
 #include "input.h"
 
 // Debounced button/axis states
-Button buttons;
+volatile u16 buttons;
 Axis axes;
 
-// Raw previous/current states of each button
-Button buttonsPrev;
-Button buttonsCur;
+// Button ports, PORTA and PORTC are the only button ports with interrupt-on-change
+#define IN_PA       0
+#define IN_PC       1
+#define IN_PD       2
+#define IN_PE       3
+#define IN_PORTS    4
 
-// Variables for counting how long a button is pressed
-u8 countA;
-u8 countB;
-u8 countX;
-u8 countY;
-u8 countDU;
-u8 countDD;
-u8 countDR;
-u8 countDL;
-u8 countL;
-u8 countZL;
-u8 countR;
-u8 countZR;
-u8 countPlus;
-u8 countMinus;
-u8 countHome;
-u8 countC;
-u8 countZ;
+#if (DBNC_CONST < 1) || (DBNC_CONST > 7)
+#error "DBNC_CONST must fit the 3-bit vertical counters (1 to 7)"
+#endif
+
+// Selects a counter bit plane or its complement to match DBNC_CONST
+#define DBNC_MATCH(plane, bit)  ((DBNC_CONST & (bit)) ? (plane) : (u8)~(plane))
+
+// An edge at least this long before the tick counts as one tick of stable level, in TMR1 counts
+#define DBNC_HALF   ((u16)(INPUT_TIME_RATE / DBNC_RATE / 2))
+
+// Captured edges waiting for the debounce tick (power of 2)
+#define EDGE_BUF_SIZE   8
+
+// Port index and pin mask of a (port, bit) pair from pin_defs.h
+#define BTN_PORT(io)            BTN_PORT_(io)
+#define BTN_PORT_(port, bit)    IN_P##port
+#define BTN_MASK(io)            BTN_MASK_(io)
+#define BTN_MASK_(port, bit)    (1 << (bit))
+
+typedef struct
+{
+    u8 port;
+    u8 mask;
+    u16 bit;
+}
+ButtonPin;
+
+typedef struct
+{
+    u16 time;   // TMR1 count when the level was read
+    u8 port;
+    u8 level;
+}
+ButtonEdge;
+
+// Pin to report bit mapping for each mode
+const ButtonPin classicPins[] =
+{
+    { BTN_PORT(A_IO),       BTN_MASK(A_IO),     BTN_A },
+    { BTN_PORT(B_IO),       BTN_MASK(B_IO),     BTN_B },
+    { BTN_PORT(X_IO),       BTN_MASK(X_IO),     BTN_X },
+    { BTN_PORT(Y_IO),       BTN_MASK(Y_IO),     BTN_Y },
+    { BTN_PORT(DU_IO),      BTN_MASK(DU_IO),    BTN_DU },
+    { BTN_PORT(DD_IO),      BTN_MASK(DD_IO),    BTN_DD },
+    { BTN_PORT(DR_IO),      BTN_MASK(DR_IO),    BTN_DR },
+    { BTN_PORT(DL_IO),      BTN_MASK(DL_IO),    BTN_DL },
+    { BTN_PORT(R_IO),       BTN_MASK(R_IO),     BTN_R },
+    { BTN_PORT(ZR_IO),      BTN_MASK(ZR_IO),    BTN_ZR },
+    { BTN_PORT(L_IO),       BTN_MASK(L_IO),     BTN_L },
+    { BTN_PORT(ZL_IO),      BTN_MASK(ZL_IO),    BTN_ZL },
+    { BTN_PORT(PLUS_IO),    BTN_MASK(PLUS_IO),  BTN_PLUS },
+    { BTN_PORT(MINUS_IO),   BTN_MASK(MINUS_IO), BTN_MINUS },
+    { BTN_PORT(HOME_IO),    BTN_MASK(HOME_IO),  BTN_HOME }
+};
+const ButtonPin nunchukPins[] =
+{
+    { BTN_PORT(C_IO),       BTN_MASK(C_IO),     BTN_C },
+    { BTN_PORT(Z_IO),       BTN_MASK(Z_IO),     BTN_Z }
+};
+
+#define CLASSIC_PINS    (sizeof(classicPins) / sizeof(ButtonPin))
+#define NUNCHUK_PINS    (sizeof(nunchukPins) / sizeof(ButtonPin))
+
+// Edge ring buffer, filled by the IOC interrupt and the debounce tick
+ButtonEdge edgeBuf[EDGE_BUF_SIZE];
+u8 edgeHead;
+u8 edgeTail;
+u8 edgeLevel[IN_PORTS];     // Last level queued for each port
+u8 edgeLost;                // Ports that dropped edges on a full buffer, one bit per port
+
+// Debounce state, only touched by the debounce tick
+u8 btnLevel[IN_PORTS];      // Pin levels after the queued edges
+u8 dbncState[IN_PORTS];     // Debounced pin levels, one bit per pin (0 = pressed)
+u8 dbncCount0[IN_PORTS];    // Vertical counters, bit n of each plane belongs to pin n
+u8 dbncCount1[IN_PORTS];
+u8 dbncCount2[IN_PORTS];
+u8 btnMode;                 // Mode selected by the main loop
+u8 btnModeActive;           // Mode the debounce state belongs to
+
+static u16 EdgeTime()
+{
+    // Low byte read latches the high byte (RD16)
+    u8 low = TMR1L;
+    return ((u16)TMR1H << 8) | low;
+}
+
+static void EdgeCapture(u8 port, u8 level)
+{
+    u8 next;
+    
+    if (level == edgeLevel[port]) return;
+    edgeLevel[port] = level;
+    
+    // A port that lost an edge is resynchronized from edgeLevel at the tick,
+    // its later edges would only take room from the other ports
+    if (edgeLost & (1 << port)) return;
+    
+    next = (edgeHead + 1) & (EDGE_BUF_SIZE - 1);
+    if (next == edgeTail)
+    {
+        edgeLost |= 1 << port;
+        return;
+    }
+    
+    edgeBuf[edgeHead].time = EdgeTime();
+    edgeBuf[edgeHead].port = port;
+    edgeBuf[edgeHead].level = level;
+    edgeHead = next;
+}
+
+u16 InputGetTime()
+{
+    u16 time;
+    
+    // An interrupt reading TMR1 in between would replace the latched high byte
+    INTCONbits.GIE = 0;
+    time = EdgeTime();
+    INTCONbits.GIE = 1;
+    
+    return time;
+}
+
+u16 InputGetTimeISR()
+{
+    return EdgeTime();
+}
 
 void InputInit()
 {
+    u8 i;
+    
     ADCinit();
     
-    buttons.A = 1;
-    buttons.B = 1;
-    buttons.X = 1;
-    buttons.Y = 1;
-    buttons.DU = 1;
-    buttons.DD = 1;
-    buttons.DR = 1;
-    buttons.DL = 1;
-    buttons.R = 1;
-    buttons.ZR = 1;
-    buttons.L = 1;
-    buttons.ZL = 1;
-    buttons.Plus = 1;
-    buttons.Minus = 1;
-    buttons.Home = 1;
+    buttons = BTN_NONE;
+    btnMode = MODE_OFF;
+    btnModeActive = MODE_OFF;
+    edgeHead = 0;
+    edgeTail = 0;
+    edgeLost = 0;
+    
+    // Edge timestamp clock: TMR1 free-running on MFINTOSC with 1:2 prescaler
+    T1CLK = 0b00000101;
+    T1GCON = 0b00000000;
+    T1CON = 0b00010011;     // 1:2 prescaler, 16-bit reads, TMR1 on
+    
+    edgeLevel[IN_PA] = PORTA;
+    edgeLevel[IN_PC] = PORTC;
+    edgeLevel[IN_PD] = PORTD;
+    edgeLevel[IN_PE] = PORTE;
+    for (i = 0; i < IN_PORTS; i++)
+    {
+        btnLevel[i] = edgeLevel[i];
+        dbncState[i] = 0xFF;
+        dbncCount0[i] = 0;
+        dbncCount1[i] = 0;
+        dbncCount2[i] = 0;
+    }
+    
+    // Both edges of every button pin that has interrupt-on-change
+    IOCAP = 0;
+    IOCCP = 0;
+    for (i = 0; i < CLASSIC_PINS; i++)
+    {
+        if (classicPins[i].port == IN_PA) IOCAP |= classicPins[i].mask;
+        if (classicPins[i].port == IN_PC) IOCCP |= classicPins[i].mask;
+    }
+    IOCAN = IOCAP;
+    IOCCN = IOCCP;
+    IOCAF = 0;
+    IOCCF = 0;
+    PIE0bits.IOCIE = 1;
+    
+    // Debounce tick: TMR4 on MFINTOSC with 1:2 prescaler
+    T4CLKCON = 0b00000101;
+    T4HLT = 0b00000000;     // Free-running period mode
+    T4PR = (MFINTOSC_FREQ / (2 * DBNC_RATE)) - 1;
+    T4CON = 0b10010000;     // TMR4 on, 1:2 prescaler, 1:1 postscaler
+    TMR4IF = 0;
+    PIE4bits.TMR4IE = 1;
     
     axes.LX = 0x7F;
     axes.LY = 0x7F;
@@ -65,203 +209,186 @@ void InputInit()
     axes.RT = 0;
 }
 
-void InputGetButtons(u8 mode)
+void InputEdgeHandle()
 {
-    switch (mode)
+    u8 flags;
+    
+    // Clear only the flags that were seen, then read the level they announced
+    flags = IOCAF;
+    if (flags)
+    {
+        IOCAF &= ~flags;
+        EdgeCapture(IN_PA, PORTA);
+    }
+    
+    flags = IOCCF;
+    if (flags)
+    {
+        IOCCF &= ~flags;
+        EdgeCapture(IN_PC, PORTC);
+    }
+}
+
+void InputTickHandle()
+{
+    const ButtonPin *map;
+    ButtonEdge *edge;
+    u8 bounced[IN_PORTS];   // Pins that moved since the last tick
+    u8 recent[IN_PORTS];    // Of those, pins whose last edge is under half a tick old
+    u8 count;
+    u8 changed;
+    u8 moved;
+    u8 delta;
+    u8 c0;
+    u8 c1;
+    u8 c2;
+    u8 done;
+    u16 state;
+    u16 now;
+    u8 i;
+    
+    // PORTD and PORTE have no interrupt-on-change, their edges are caught here
+    EdgeCapture(IN_PD, PORTD);
+    EdgeCapture(IN_PE, PORTE);
+    now = EdgeTime();
+    
+    switch (btnMode)
     {
         case MODE_CLASSIC:
-            // Store most recent button state
-            buttonsCur.A = A_PIN;
-            buttonsCur.B = B_PIN;
-            buttonsCur.X = X_PIN;
-            buttonsCur.Y = Y_PIN;
-            buttonsCur.DU = DU_PIN;
-            buttonsCur.DD = DD_PIN;
-            buttonsCur.DR = DR_PIN;
-            buttonsCur.DL = DL_PIN;
-            buttonsCur.R = R_PIN;
-            buttonsCur.ZR = ZR_PIN;
-            buttonsCur.L = L_PIN;
-            buttonsCur.ZL = ZL_PIN;
-            buttonsCur.Plus = PLUS_PIN;
-            buttonsCur.Minus = MINUS_PIN;
-            buttonsCur.Home = HOME_PIN;
-            
-            // Increase count if button is pressed
-            if (!buttonsCur.A) countA++;
-            if (!buttonsCur.B) countB++;
-            if (!buttonsCur.X) countX++;
-            if (!buttonsCur.Y) countY++;
-            if (!buttonsCur.DU) countDU++;
-            if (!buttonsCur.DD) countDD++;
-            if (!buttonsCur.DR) countDR++;
-            if (!buttonsCur.DL) countDL++;
-            if (!buttonsCur.R) countR++;
-            if (!buttonsCur.ZR) countZR++;
-            if (!buttonsCur.L) countL++;
-            if (!buttonsCur.ZL) countZL++;
-            if (!buttonsCur.Plus) countPlus++;
-            if (!buttonsCur.Minus) countMinus++;
-            if (!buttonsCur.Home) countHome++;
-            
-            // Clear button if button state has changed
-            if (buttonsPrev.A ^ buttonsCur.A)
-            {
-                countA = 0;
-                buttons.A = 1;
-            }
-            if (buttonsPrev.B ^ buttonsCur.B)
-            {
-                countB = 0;
-                buttons.B = 1;
-            }
-            if (buttonsPrev.X ^ buttonsCur.X)
-            {
-                countX = 0;
-                buttons.X = 1;
-            }
-            if (buttonsPrev.Y ^ buttonsCur.Y)
-            {
-                countY = 0;
-                buttons.Y = 1;
-            }
-            if (buttonsPrev.DU ^ buttonsCur.DU)
-            {
-                countDU = 0;
-                buttons.DU = 1;
-            }
-            if (buttonsPrev.DD ^ buttonsCur.DD)
-            {
-                countDD = 0;
-                buttons.DD = 1;
-            }
-            if (buttonsPrev.DR ^ buttonsCur.DR)
-            {
-                countDR = 0;
-                buttons.DR = 1;
-            }
-            if (buttonsPrev.DL ^ buttonsCur.DL)
-            {
-                countDL = 0;
-                buttons.DL = 1;
-            }
-            if (buttonsPrev.R ^ buttonsCur.R)
-            {
-                countR = 0;
-                buttons.R = 1;
-            }
-            if (buttonsPrev.ZR ^ buttonsCur.ZR)
-            {
-                countZR = 0;
-                buttons.ZR = 1;
-            }
-            if (buttonsPrev.L ^ buttonsCur.L)
-            {
-                countL = 0;
-                buttons.L = 1;
-            }
-            if (buttonsPrev.ZL ^ buttonsCur.ZL)
-            {
-                countZL = 0;
-                buttons.ZL = 1;
-            }
-            if (buttonsPrev.Plus ^ buttonsCur.Plus)
-            {
-                countPlus = 0;
-                buttons.Plus = 1;
-            }
-            if (buttonsPrev.Minus ^ buttonsCur.Minus)
-            {
-                countMinus = 0;
-                buttons.Minus = 1;
-            }
-            if (buttonsPrev.Home ^ buttonsCur.Home)
-            {
-                countHome = 0;
-                buttons.Home = 1;
-            }
-            
-            // Store current button states for next check
-            buttonsPrev.A = buttonsCur.A;
-            buttonsPrev.B = buttonsCur.B;
-            buttonsPrev.X = buttonsCur.X;
-            buttonsPrev.Y = buttonsCur.Y;
-            buttonsPrev.DU = buttonsCur.DU;
-            buttonsPrev.DD = buttonsCur.DD;
-            buttonsPrev.DR = buttonsCur.DR;
-            buttonsPrev.DL = buttonsCur.DL;
-            buttonsPrev.R = buttonsCur.R;
-            buttonsPrev.ZR = buttonsCur.ZR;
-            buttonsPrev.L = buttonsCur.L;
-            buttonsPrev.ZL = buttonsCur.ZL;
-            buttonsPrev.Plus = buttonsCur.Plus;
-            buttonsPrev.Minus = buttonsCur.Minus;
-            buttonsPrev.Home = buttonsCur.Home;
-                
-            // Set button if count has reached threshold
-            if (countA >= DBNC_CONST) buttons.A = 0;
-            if (countB >= DBNC_CONST) buttons.B = 0;
-            if (countX >= DBNC_CONST) buttons.X = 0;
-            if (countY >= DBNC_CONST) buttons.Y = 0;
-            if (countDU >= DBNC_CONST) buttons.DU = 0;
-            if (countDD >= DBNC_CONST) buttons.DD = 0;
-            if (countDR >= DBNC_CONST) buttons.DR = 0;
-            if (countDL >= DBNC_CONST) buttons.DL = 0;
-            if (countR >= DBNC_CONST) buttons.R = 0;
-            if (countZR >= DBNC_CONST) buttons.ZR = 0;
-            if (countL >= DBNC_CONST) buttons.L = 0;
-            if (countZL >= DBNC_CONST) buttons.ZL = 0;
-            if (countPlus >= DBNC_CONST) buttons.Plus = 0;
-            if (countMinus >= DBNC_CONST) buttons.Minus = 0;
-            if (countHome >= DBNC_CONST) buttons.Home = 0;
+            map = classicPins;
+            count = CLASSIC_PINS;
             break;
             
         case MODE_NUNCHUK:
-            // Store most recent button state
-            buttonsCur.C = C_PIN;
-            buttonsCur.Z = Z_PIN;
-            
-            // Increase count if button is pressed
-            if (!buttonsCur.C) countC++;
-            if (!buttonsCur.Z) countZ++;
-            
-            // Clear button if button state has changed
-            if (buttonsPrev.C ^ buttonsCur.C)
-            {
-                countC = 0;
-                buttons.C = 1;
-            }
-            if (buttonsPrev.Z ^ buttonsCur.Z)
-            {
-                countZ = 0;
-                buttons.Z = 1;
-            }
-            
-            // Store current button states for next check
-            buttonsPrev.C = buttonsCur.C;
-            buttonsPrev.Z = buttonsCur.Z;
-                
-            // Set button if count has reached threshold
-            if (countC >= DBNC_CONST) buttons.C = 0;
-            if (countZ >= DBNC_CONST) buttons.Z = 0;
+            map = nunchukPins;
+            count = NUNCHUK_PINS;
             break;
             
         default:
-            break;
+            edgeTail = edgeHead;
+            buttons = BTN_NONE;
+            btnModeActive = btnMode;
+            return;
     }
+    
+    for (i = 0; i < IN_PORTS; i++)
+    {
+        bounced[i] = 0;
+        recent[i] = 0;
+    }
+    moved = 0;
+    
+    // Restart debouncing of every port from the current levels after a mode change
+    if (btnModeActive != btnMode)
+    {
+        btnModeActive = btnMode;
+        buttons = BTN_NONE;
+        for (i = 0; i < IN_PORTS; i++) dbncState[i] = 0xFF;
+        edgeLost = (1 << IN_PORTS) - 1;
+    }
+    
+    // Replay queued edges into port masks of the pins that moved and how recently
+    while (edgeTail != edgeHead)
+    {
+        edge = &edgeBuf[edgeTail];
+        changed = btnLevel[edge->port] ^ edge->level;
+        btnLevel[edge->port] = edge->level;
+        bounced[edge->port] |= changed;
+        if ((u16)(now - edge->time) < DBNC_HALF) recent[edge->port] |= changed;
+        else recent[edge->port] &= ~changed;
+        
+        edgeTail = (edgeTail + 1) & (EDGE_BUF_SIZE - 1);
+    }
+    
+    // Ports that lost edges restart debouncing from their current level, the
+    // others keep counting
+    if (edgeLost)
+    {
+        for (i = 0; i < IN_PORTS; i++)
+        {
+            if (!(edgeLost & (1 << i))) continue;
+            btnLevel[i] = edgeLevel[i];
+            bounced[i] = 0xFF;
+            recent[i] = 0xFF;
+        }
+        edgeLost = 0;
+        moved = 1;
+    }
+    
+    // Every pin of a port at once with 3-bit vertical counters
+    for (i = 0; i < IN_PORTS; i++)
+    {
+        // Releases take effect right away
+        changed = dbncState[i];
+        dbncState[i] |= btnLevel[i];
+        
+        // Count ticks of pins held low while still released
+        delta = dbncState[i] & ~btnLevel[i];
+        c2 = (dbncCount2[i] ^ (dbncCount1[i] & dbncCount0[i])) & delta;
+        c1 = (dbncCount1[i] ^ dbncCount0[i]) & delta;
+        c0 = ~dbncCount0[i] & delta;
+        
+        // Pins that moved count again from their last edge, which is one tick
+        // of stable level already if it came at least half a tick ago
+        c2 &= ~bounced[i];
+        c1 &= ~bounced[i];
+        c0 = (c0 & ~bounced[i]) | (bounced[i] & ~recent[i] & delta);
+        
+        // Press pins whose count has reached the threshold
+        done = DBNC_MATCH(c0, 0x01) & DBNC_MATCH(c1, 0x02) & DBNC_MATCH(c2, 0x04) & delta;
+        dbncState[i] &= ~done;
+        
+        dbncCount0[i] = c0 & ~done;
+        dbncCount1[i] = c1 & ~done;
+        dbncCount2[i] = c2 & ~done;
+        
+        moved |= changed ^ dbncState[i];
+    }
+    
+    if (!moved) return;
+    
+    // Clear the report bit of every pressed button
+    state = BTN_NONE;
+    for (i = 0; i < count; i++)
+    {
+        if (!(dbncState[map[i].port] & map[i].mask)) state &= ~map[i].bit;
+    }
+    buttons = state;
+}
+
+void InputGetButtons(u8 mode)
+{
+    // Capture and debouncing run from the interrupt, only the pin map follows the mode
+    btnMode = mode;
+}
+
+static u8 InputAxisRound(u16 adc)
+{
+    // 12-bit average to the nearest 8-bit value
+    adc = (adc + (1 << (ADC_FRAC_BITS + 1))) >> (ADC_FRAC_BITS + 2);
+    return (adc > 255) ? 255 : adc;
 }
 
 void InputGetAxes(u8 mode)
 {      
+    u16 adc[ADC_SCAN_COUNT];
+    s16 accel[3];
+    
     switch (mode)
     {
         case MODE_NUNCHUK:            
-            // Read accelerometer values if IMU is initialized
+            // Finish IMU bring-up once it answers
+            IMUtask();
+            
+            // Read accelerometer values if IMU is initialized, previous sample is kept until a new one is ready
             if (IMUisEnabled())
             {
-                axes.AX = IMUreadAccelX() >> 6;
-                axes.AY = IMUreadAccelY() >> 6;
-                axes.AZ = IMUreadAccelZ() >> 6;
+                if (IMUreadAccel(accel))
+                {
+                    axes.AX = accel[0] >> 6;
+                    axes.AY = accel[1] >> 6;
+                    axes.AZ = accel[2] >> 6;
+                }
             }
             else
             {
@@ -271,12 +398,15 @@ void InputGetAxes(u8 mode)
             }
         
         case MODE_CLASSIC:
-            axes.LX = ADCread(LX_CH) >> 2;
-            axes.LY = ADCread(LY_CH) >> 2;
-            axes.RX = ADCread(RX_CH) >> 2;
-            axes.RY = ADCread(RY_CH) >> 2;
-            axes.LT = ADCread(LT_CH) >> 2;
-            axes.RT = ADCread(RT_CH) >> 2;
+            // Latest complete set from the background scan
+            ADCscanRead(adc);
+            
+            axes.LX = InputAxisRound(adc[ADC_LX]);
+            axes.LY = InputAxisRound(adc[ADC_LY]);
+            axes.RX = InputAxisRound(adc[ADC_RX]);
+            axes.RY = InputAxisRound(adc[ADC_RY]);
+            axes.LT = InputAxisRound(adc[ADC_LT]);
+            axes.RT = InputAxisRound(adc[ADC_RT]);
             break;
             
         default:
@@ -6,27 +6,30 @@
 #ifndef _INPUT_H_
 #define	_INPUT_H_
 
-typedef struct
-{
-    u8 A;
-    u8 B;
-    u8 X;
-    u8 Y;
-    u8 DU;
-    u8 DD;
-    u8 DR;
-    u8 DL;
-    u8 R;
-    u8 ZR;
-    u8 L;
-    u8 ZL;
-    u8 Plus;
-    u8 Minus;
-    u8 Home;
-    u8 C;
-    u8 Z;
-} 
-Button;
+// Packed button word in Classic Controller report order, active low
+// High byte is report byte 4, low byte is report byte 5 (byte 6/7 in full mode)
+#define BTN_DR      0x8000
+#define BTN_DD      0x4000
+#define BTN_L       0x2000
+#define BTN_MINUS   0x1000
+#define BTN_HOME    0x0800
+#define BTN_PLUS    0x0400
+#define BTN_R       0x0200
+#define BTN_ZL      0x0080
+#define BTN_B       0x0040
+#define BTN_Y       0x0020
+#define BTN_A       0x0010
+#define BTN_X       0x0008
+#define BTN_ZR      0x0004
+#define BTN_DL      0x0002
+#define BTN_DU      0x0001
+
+// Nunchuk buttons sit at their report byte 5 positions
+#define BTN_C       0x0002
+#define BTN_Z       0x0001
+
+// All buttons released
+#define BTN_NONE    0xFFFF
 
 typedef struct
 {
@@ -43,14 +46,28 @@ typedef struct
 Axis;
 
 // Button/axis states
-extern Button buttons;
+extern volatile u16 buttons;
 extern Axis axes;
 
-// Number of cycles required for valid button input
+// Input time (edge timestamps): TMR1 on MFINTOSC with 1:2 prescaler, counts per second
+#define INPUT_TIME_RATE (MFINTOSC_FREQ / 2)
+
+// Debounce ticks per second
+#define DBNC_RATE   1000
+
+// Number of ticks a button must be held low for valid button input
 #define DBNC_CONST  5
 
+u16 InputGetTime();
+
+u16 InputGetTimeISR();
+
 void InputInit();
 
+void InputEdgeHandle();
+
+void InputTickHandle();
+
 void InputGetButtons(u8 mode);
 
 void InputGetAxes(u8 mode);
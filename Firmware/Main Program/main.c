@@ -44,9 +44,12 @@
 #include "pin_defs.h"
 #include "input.h"
 #include "ADC.h"
+#include "clock.h"
 #include "MSSP.h"
 #include "expansion.h"
 #include "camera.h"
+#include "poll.h"
+#include "prof.h"
 
 u8 mode;
 u8 newMode;
@@ -68,7 +71,7 @@ void PPSlock()
 void PICinit()
 {
     // INTOSC = 8 MHz
-    OSCCON1bits.NDIV = 2;
+    ClockSet(CLK_8MHZ);
     
     INTCONbits.GIE = 0;
     PPSunlock();
@@ -120,26 +123,55 @@ void PICinit()
 void BeginBootloader()
 {
     // Go to bootloader address
+#ifdef SIM_HOST
+    SimJump(BOOT_ADDR);
+#else
     #asm
         GOTO BOOT_ADDR;
     #endasm
+#endif
 }
 
 void interrupt ISR()
 {   
+    PROF_ISR();
+    
     if (SSP1IF)
     {       
+        SSP1IF = 0;         // Cleared first so an event during the handler is not lost
+        
+        PROF_BEGIN(PROF_I2C);
         I2CslaveHandle();
-        I2CslaveRelease();
+        PROF_END(PROF_I2C);
+    }
+    
+    if (IOCIF)
+    {
+        InputEdgeHandle();  // Clears the IOC flags it handled
+    }
+    
+    if (ADTIF)
+    {
+        ADCscanHandle();
         
-        SSP1IF = 0;
+        ADTIF = 0;
+    }
+    
+    if (TMR4IF)
+    {
+        InputTickHandle();
+        
+        TMR4IF = 0;
     }
 }
 
 void main()
 {
+    u8 busy;
+    
     PICinit();
     InputInit();
+    PROF_INIT();
     
     mode = 0xFF;
     newMode = 0;
@@ -163,13 +195,45 @@ void main()
         
         if (ExpIsEnabled())
         {
-            InputGetButtons(mode);  // Get current button states
-            InputGetAxes(mode);     // Get current axis states
-            ExpUpdate();            // Send controller data to Wii Remote
-            CamUpdateBlobs();       // Send camera data to Wii Remote
+            PROF_BEGIN(PROF_LOOP);
+            ClockTask();            // Core clock follows the bus
+            PollTask();             // Track the host's read cadence
+            
+            // Sample just ahead of the next predicted read
+            if (PollSampleDue())
+            {
+                u16 start = InputGetTime();
+                
+                InputGetButtons(mode);  // Get current button states
+                PROF_BEGIN(PROF_AXES);
+                InputGetAxes(mode);     // Get current axis states
+                PROF_END(PROF_AXES);
+                PROF_BEGIN(PROF_EXP);
+                ExpUpdate();            // Send controller data to Wii Remote
+                PROF_END(PROF_EXP);
+                PROF_BEGIN(PROF_CAM);
+                CamUpdateBlobs();       // Send camera data to Wii Remote
+                PROF_END(PROF_CAM);
+                I2CreportPublish(start);// Serve this sample from the next read
+                PollSampleDone(start);
+            }
+            
+            busy = ExpTask();       // Background table rebuilds
             
             // Execute special commands, go to bootloader if triggered
             if (ExpCmdExec()) BeginBootloader();
+            
+            PROF_END(PROF_LOOP);
+            PROF_TASK();            // Refresh the profiler registers, outside the pass it measures
+            
+            // Event-driven refresh: doze until the next sample is due. With interrupts
+            // off, a read ending after PollIdle() leaves its flag set and is not slept through.
+            if (!busy && PollIdle())
+            {
+                INTCONbits.GIE = 0;
+                if (!I2CconsumedPending()) ClockIdle();
+                INTCONbits.GIE = 1;
+            }
         }
     }
 }
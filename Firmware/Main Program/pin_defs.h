@@ -6,22 +6,45 @@
 #ifndef _PIN_DEFS_H_
 #define	_PIN_DEFS_H_
 
+// Builds a pin name such as RA4 from a (port, bit) pair
+#define PIN(io)             PIN_(io)
+#define PIN_(port, bit)     R##port##bit
+
+// Button pin locations (port, bit)
+#define A_IO        A, 4
+#define B_IO        A, 5
+#define X_IO        E, 0
+#define Y_IO        E, 1
+#define DU_IO       D, 6
+#define DD_IO       D, 5
+#define DR_IO       D, 4
+#define DL_IO       C, 7
+#define R_IO        D, 0
+#define ZR_IO       D, 1
+#define L_IO        D, 3
+#define ZL_IO       D, 2
+#define PLUS_IO     E, 2
+#define MINUS_IO    A, 6
+#define HOME_IO     A, 7
+#define C_IO        L_IO
+#define Z_IO        ZL_IO
+
 // Button pin definitions
-#define A_PIN       RA4
-#define B_PIN       RA5
-#define X_PIN       RE0
-#define Y_PIN       RE1
-#define DU_PIN      RD6
-#define DD_PIN      RD5
-#define DR_PIN      RD4
-#define DL_PIN      RC7
-#define R_PIN       RD0
-#define ZR_PIN      RD1
-#define L_PIN       RD3
-#define ZL_PIN      RD2
-#define PLUS_PIN    RE2
-#define MINUS_PIN   RA6
-#define HOME_PIN    RA7
+#define A_PIN       PIN(A_IO)
+#define B_PIN       PIN(B_IO)
+#define X_PIN       PIN(X_IO)
+#define Y_PIN       PIN(Y_IO)
+#define DU_PIN      PIN(DU_IO)
+#define DD_PIN      PIN(DD_IO)
+#define DR_PIN      PIN(DR_IO)
+#define DL_PIN      PIN(DL_IO)
+#define R_PIN       PIN(R_IO)
+#define ZR_PIN      PIN(ZR_IO)
+#define L_PIN       PIN(L_IO)
+#define ZL_PIN      PIN(ZL_IO)
+#define PLUS_PIN    PIN(PLUS_IO)
+#define MINUS_PIN   PIN(MINUS_IO)
+#define HOME_PIN    PIN(HOME_IO)
 #define C_PIN       L_PIN
 #define Z_PIN       ZL_PIN
 
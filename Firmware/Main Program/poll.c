@@ -0,0 +1,190 @@
+/*
+ * File:   poll.c
+ * Author: Jackson Snowden
+ */
+
+#include <xc.h>
+#include "config.h"
+#include "input.h"
+#include "MSSP.h"
+#include "expansion.h"
+#include "poll.h"
+
+// Input time conversions
+#define POLL_US_PER_TICK    (1000000 / INPUT_TIME_RATE)
+#define POLL_TICKS(us)      ((u16)((us) / POLL_US_PER_TICK))
+
+u16 pollPeriod;     // Estimated time between host reads in input time ticks, 0 until known
+u16 pollCandidate;  // Last interval while pollPeriod is unknown
+u16 pollJitter;     // Mean deviation of the read intervals from pollPeriod
+u16 pollLast;       // Input time of the last read
+u16 pollCost;       // Time a sample takes from start to publish, peak held
+u8 pollCount;       // Reads seen so far
+u8 pollMiss;        // Consecutive reads off the estimated cadence
+u8 pollMode = POLL_MODE_DEFAULT;
+u8 pollArmed;       // Event mode: the host read the last report, sample the next one
+u16 pollStart;      // Input time the last sample started
+u16 pollLatch;      // Event mode: input time the sample for the next read is due at
+
+// Main loop passes without a sample, including any time spent idle. The
+// latch can start up to one of these late.
+u16 pollIdle;       // Longest recent one, peak held
+u16 pollPassTime;   // Input time of the last PollTask() call
+u8 pollBusy;        // The last pass took a sample
+
+static void PollWriteUs(u8 addr, u16 ticks)
+{
+    u16 us = (ticks > 0xFFFF / POLL_US_PER_TICK) ? 0xFFFF : ticks * POLL_US_PER_TICK;
+    
+    I2CslaveWrite(addr, us >> 8);
+    I2CslaveWrite(addr + 1, us & 0xFF);
+}
+
+void PollInit()
+{
+    u16 age;
+    
+    pollPeriod = 0;
+    pollCandidate = 0;
+    pollJitter = 0;
+    pollCost = 0;
+    pollMiss = 0;
+    pollIdle = 0;
+    pollBusy = 1;
+    pollArmed = 0;
+    pollPassTime = InputGetTime();
+    pollStart = pollPassTime;
+    pollCount = I2CpollGet(&pollLast, &age);
+    
+    PollWriteUs(EXP_REG_POLL_PER, 0);
+    PollWriteUs(EXP_REG_POLL_AGE, 0);
+}
+
+void PollSetMode(u8 mode)
+{
+    if (mode >= POLL_MODE_COUNT) mode = POLL_MODE_DEFAULT;
+    pollMode = mode;
+}
+
+static void PollMiss(u16 interval)
+{
+    // A few reads off the cadence in a row mean the host changed its rate
+    if (++pollMiss >= POLL_MISS_MAX)
+    {
+        pollPeriod = 0;
+        pollCandidate = interval;
+    }
+}
+
+void PollTask()
+{
+    u16 now = InputGetTime();
+    u16 time;
+    u16 age;
+    u16 interval;
+    u16 err;
+    u8 count;
+    u8 reads;
+    
+    // Length of the pass that just ended
+    interval = now - pollPassTime;
+    pollPassTime = now;
+    if (!pollBusy)
+    {
+        if (interval > pollIdle) pollIdle = interval;
+        else pollIdle -= (pollIdle - interval) >> 4;
+    }
+    pollBusy = 0;
+    
+    count = I2CpollGet(&time, &age);
+    reads = count - pollCount;
+    if (!reads) return;
+    
+    pollCount = count;
+    interval = time - pollLast;
+    pollLast = time;
+    
+    // An interval is only known when exactly one read happened since the last pass
+    if (reads == 1)
+    {
+        if ((interval < POLL_TICKS(POLL_MIN_US)) || (interval > POLL_TICKS(POLL_MAX_US)))
+        {
+            if (pollPeriod) PollMiss(0);
+            else pollCandidate = 0;
+        }
+        else if (!pollPeriod)
+        {
+            // Lock once two intervals in a row agree, connection set-up reads are irregular
+            err = (interval > pollCandidate) ? interval - pollCandidate : pollCandidate - interval;
+            if (err <= (interval >> 3))
+            {
+                pollPeriod = pollCandidate + (s16)(interval - pollCandidate) / 2;
+                pollJitter = err;
+                pollMiss = 0;
+            }
+            pollCandidate = interval;
+        }
+        else
+        {
+            err = (interval > pollPeriod) ? interval - pollPeriod : pollPeriod - interval;
+            if (err > (pollPeriod >> 2)) PollMiss(interval);
+            else
+            {
+                pollMiss = 0;
+                pollPeriod = pollPeriod + (s16)(interval - pollPeriod) / 8;
+                pollJitter = pollJitter + (s16)(err - pollJitter) / 8;
+            }
+        }
+    }
+    
+    // Latest start for the next read's sample: it may begin up to one idle pass
+    // late and the read may come early by the jitter
+    pollLatch = time + pollPeriod - (pollCost + pollIdle + (pollJitter << 1) + POLL_TICKS(POLL_MARGIN_US));
+    
+    PollWriteUs(EXP_REG_POLL_PER, pollPeriod);
+    PollWriteUs(EXP_REG_POLL_AGE, age);
+}
+
+static u8 PollLatchDue(u16 now)
+{
+    // Event mode: one sample per report the host reads. It is taken straight
+    // away until the cadence is known, then as late as it can still be
+    // published before the predicted read. A host away for POLL_MAX_US gets
+    // a fresh report whatever the state.
+    if (I2CwasConsumed()) pollArmed = 1;
+    if ((u16)(now - pollStart) >= POLL_TICKS(POLL_MAX_US)) return 1;
+    if (!pollArmed) return 0;
+    if (!pollPeriod) return 1;
+    
+    return ((s16)(now - pollLatch) >= 0);
+}
+
+u8 PollSampleDue()
+{
+    if (pollMode != POLL_MODE_EVENT) return 1;
+    if (!PollLatchDue(InputGetTime())) return 0;
+    
+    pollArmed = 0;
+    return 1;
+}
+
+void PollSampleDone(u16 start)
+{
+    u16 cost = InputGetTime() - start;
+    
+    // Follow slower samples at once, faster ones only slowly: a latch that
+    // publishes after the read serves a sample a whole period old
+    if (cost > pollCost) pollCost = cost;
+    else pollCost -= (pollCost - cost) >> 6;
+    
+    pollStart = start;
+    pollBusy = 1;
+}
+
+u8 PollIdle()
+{
+    // Nothing is due until the next interrupt. A latch that falls due before
+    // the core dozes off starts at the next wake-up, pollIdle allows for that.
+    if (pollMode != POLL_MODE_EVENT) return 0;
+    return !PollLatchDue(InputGetTime());
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+/* 
+ * File:   poll.h  
+ * Author: Jackson Snowden
+ */
+
+#ifndef _POLL_H_
+#define	_POLL_H_
+
+// Host poll periods the estimator accepts
+#define POLL_MIN_US     2000
+#define POLL_MAX_US     50000
+
+// Sampling finishes this long before the predicted read, plus twice the observed jitter
+#define POLL_MARGIN_US  50
+
+// Consecutive reads off the estimated cadence before it is dropped
+#define POLL_MISS_MAX   4
+
+// Report refresh modes (EXP_REG_POLL_CFG)
+#define POLL_MODE_AUTO      0   // Sample every pass
+#define POLL_MODE_EVENT     1   // Sample once per host read, just ahead of it once the cadence is known, idle in between
+#define POLL_MODE_COUNT     2
+#define POLL_MODE_DEFAULT   POLL_MODE_AUTO
+
+void PollInit();
+
+void PollSetMode(u8 mode);
+
+void PollTask();
+
+u8 PollSampleDue();
+
+void PollSampleDone(u16 start);
+
+u8 PollIdle();
+
+#endif  /* _POLL_H_ */
\ No newline at end of file
@@ -0,0 +1,172 @@
+/*
+ * File:   prof.c
+ * Author: Jackson Snowden
+ */
+
+#include <xc.h>
+#include "config.h"
+#include "input.h"
+#include "MSSP.h"
+#include "expansion.h"
+#include "prof.h"
+
+#if PROF_EN
+
+#define PROF_PUBLISH_TICKS  ((u16)(INPUT_TIME_RATE / 1000 * PROF_PUBLISH_MS))
+
+typedef struct
+{
+    u16 min;
+    u16 max;
+    u16 mean;
+    u8 hist[PROF_BUCKETS];
+    u8 seen;
+}
+ProfStage;
+
+ProfStage profStages[PROF_STAGES];
+u16 profStart[PROF_STAGES];     // Timer count each stage last began at
+u16 profIsrs;
+u16 profStretch;
+u16 profPublishTime;            // Input time the registers were last written
+
+static u16 ProfTime()
+{
+    u8 high;
+    u8 low;
+    
+    // RD16 is off, so an interrupt reading the timer meanwhile does no harm.
+    // A low byte rollover between the reads shows up as a new high byte.
+    do
+    {
+        high = TMR3H;
+        low = TMR3L;
+    }
+    while (high != TMR3H);
+    
+    return ((u16)high << 8) | low;
+}
+
+static void ProfWrite16(u8 addr, u16 value)
+{
+    I2CslaveWrite(addr, value >> 8);
+    I2CslaveWrite(addr + 1, value & 0xFF);
+}
+
+void ProfInit()
+{
+    // Stage clock: TMR3 free-running on HFINTOSC with 1:8 prescaler
+    T3CLK = 0b00000011;
+    T3GCON = 0b00000000;
+    T3CON = 0b00110001;     // 1:8 prescaler, 8-bit reads, TMR3 on
+    
+    ProfReset();
+}
+
+void ProfReset()
+{
+    u8 s;
+    u8 i;
+    
+    INTCONbits.GIE = 0;
+    for (s = 0; s < PROF_STAGES; s++)
+    {
+        profStages[s].min = 0xFFFF;
+        profStages[s].max = 0;
+        profStages[s].mean = 0;
+        for (i = 0; i < PROF_BUCKETS; i++) profStages[s].hist[i] = 0;
+        profStages[s].seen = 0;
+    }
+    profIsrs = 0;
+    profStretch = 0;
+    INTCONbits.GIE = 1;
+    
+    // Publish at the next ProfTask()
+    profPublishTime = InputGetTime() - PROF_PUBLISH_TICKS;
+}
+
+void ProfTask()
+{
+    ProfStage stage;
+    u16 isrs;
+    u16 stretch;
+    u8 addr;
+    u8 s;
+    u8 i;
+    
+    if ((u16)(InputGetTime() - profPublishTime) < PROF_PUBLISH_TICKS) return;
+    profPublishTime += PROF_PUBLISH_TICKS;
+    
+    INTCONbits.GIE = 0;
+    isrs = profIsrs;
+    stretch = profStretch;
+    INTCONbits.GIE = 1;
+    
+    ProfWrite16(EXP_REG_PROF + PROF_REG_ISRS, isrs);
+    ProfWrite16(EXP_REG_PROF + PROF_REG_STRETCH, stretch);
+    
+    addr = EXP_REG_PROF + PROF_REG_STAGES;
+    for (s = 0; s < PROF_STAGES; s++)
+    {
+        // A consistent copy, the I2C stage is updated by the interrupt
+        INTCONbits.GIE = 0;
+        stage = profStages[s];
+        INTCONbits.GIE = 1;
+        
+        ProfWrite16(addr + PROF_STAGE_MIN, stage.min);
+        ProfWrite16(addr + PROF_STAGE_MAX, stage.max);
+        ProfWrite16(addr + PROF_STAGE_MEAN, stage.mean);
+        for (i = 0; i < PROF_BUCKETS; i++) I2CslaveWrite(addr + PROF_STAGE_HIST + i, stage.hist[i]);
+        addr += PROF_STAGE_SIZE;
+    }
+}
+
+void ProfBegin(u8 stage)
+{
+    profStart[stage] = ProfTime();
+}
+
+void ProfEnd(u8 stage)
+{
+    ProfStage *p = &profStages[stage];
+    u16 t = ProfTime() - profStart[stage];
+    u16 u;
+    u8 b;
+    u8 i;
+    
+    if (t < p->min) p->min = t;
+    if (t > p->max) p->max = t;
+    
+    if (!p->seen)
+    {
+        p->mean = t;
+        p->seen = 1;
+    }
+    else if (t >= p->mean) p->mean += (t - p->mean) >> 4;
+    else p->mean -= (p->mean - t) >> 4;
+    
+    // Powers of two from 2 us
+    u = t >> 3;
+    for (b = 0; u && (b < PROF_BUCKETS - 1); b++) u >>= 1;
+    
+    // Halving every bucket keeps the shape of the distribution
+    if (++p->hist[b] == 0xFF)
+    {
+        for (i = 0; i < PROF_BUCKETS; i++) p->hist[i] >>= 1;
+    }
+}
+
+void ProfIsr()
+{
+    profIsrs++;
+}
+
+void ProfRelease()
+{
+    // Interrupt only: the clock has been held since at least the handler began
+    u16 t = ProfTime() - profStart[PROF_I2C];
+    
+    if (t > profStretch) profStretch = t;
+}
+
+#endif
\ No newline at end of file
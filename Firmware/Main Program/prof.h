@@ -0,0 +1,69 @@
+/* 
+ * File:   prof.h  
+ * Author: Jackson Snowden
+ */
+
+#ifndef _PROF_H_
+#define	_PROF_H_
+
+// Profiled stages
+#define PROF_LOOP       0   // Main loop pass, up to the idle doze
+#define PROF_I2C        1   // I2CslaveHandle()
+#define PROF_EXP        2   // ExpUpdate()
+#define PROF_AXES       3   // InputGetAxes()
+#define PROF_CAM        4   // CamUpdateBlobs()
+#define PROF_STAGES     5
+
+// Times are TMR3 counts on HFINTOSC / 8, 0.25 us whatever the core clock
+#define PROF_TICK_NS    250
+
+// Histogram buckets: under 2, 4, 8, 16, 32, 64 and 128 us, then 128 us and over
+#define PROF_BUCKETS    8
+
+// Register block from EXP_REG_PROF, 16-bit values MSB first
+#define PROF_REG_ISRS       0x00    // Interrupts taken, wraps
+#define PROF_REG_STRETCH    0x02    // Longest SCL hold, interrupt entry to clock release
+#define PROF_REG_STAGES     0x04    // One record per stage, in stage order
+#define PROF_STAGE_MIN      0x00    // 0xFFFF until the stage has run
+#define PROF_STAGE_MAX      0x02
+#define PROF_STAGE_MEAN     0x04    // Running mean, about the last 16 runs
+#define PROF_STAGE_HIST     0x06    // Bucket counts, all halved when one fills up
+#define PROF_STAGE_SIZE     (PROF_STAGE_HIST + PROF_BUCKETS)
+#define PROF_SIZE           (PROF_REG_STAGES + PROF_STAGES * PROF_STAGE_SIZE)
+
+// Register refresh interval
+#define PROF_PUBLISH_MS     100
+
+#if PROF_EN
+#define PROF_INIT()         ProfInit()
+#define PROF_RESET()        ProfReset()
+#define PROF_TASK()         ProfTask()
+#define PROF_BEGIN(stage)   ProfBegin(stage)
+#define PROF_END(stage)     ProfEnd(stage)
+#define PROF_ISR()          ProfIsr()
+#define PROF_RELEASE()      ProfRelease()
+#else
+#define PROF_INIT()
+#define PROF_RESET()
+#define PROF_TASK()
+#define PROF_BEGIN(stage)
+#define PROF_END(stage)
+#define PROF_ISR()
+#define PROF_RELEASE()
+#endif
+
+void ProfInit();
+
+void ProfReset();
+
+void ProfTask();
+
+void ProfBegin(u8 stage);
+
+void ProfEnd(u8 stage);
+
+void ProfIsr();
+
+void ProfRelease();
+
+#endif  /* _PROF_H_ */
\ No newline at end of file
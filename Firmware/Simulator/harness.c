@@ -0,0 +1,322 @@
+/*
+ * File:   harness.c
+ * Author: Jackson Snowden
+ *
+ * Host entry point. Brings up the simulated board, runs the unmodified
+ * firmware for a fixed amount of simulated time against a polling Wii
+ * Remote and reports where the cycles went and how long input changes take
+ * to reach the host. Boot times are measured from power-on: the first
+ * report, and the first valid one (carrying accelerometer data in Nunchuk
+ * mode with an IMU fitted).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pins.h"
+#include "config.h"
+#include "NVM.h"
+#include "clock.h"
+#include "MSSP.h"
+#include "expansion.h"
+#include "prof.h"
+#include "wiimote.h"
+#include "latency.h"
+#include "harness.h"
+
+#define CONNECT_TIMEOUT SIM_TICKS_MS(5000)
+
+// Same values ExpCalStoreDefault() writes
+static const uint8_t defaultCal[14] = { 0, 0, 255, 255, 0, 0, 255, 255, 10, 10, 0, 0, 3, 50 };
+
+static const char *stateNames[SIM_I2C_STATES] = { "write addr", "write data", "read addr", "read data" };
+
+static SimTime firstValid;
+static uint8_t waitIMU;
+
+// Sample-to-read ages reported by the firmware, one poll behind
+static uint32_t ageCount;
+static uint64_t ageTotal;
+static uint16_t ageMax;
+
+static uint16_t HarnessReg16(uint8_t addr)
+{
+    return (I2CslaveRead(addr) << 8) | I2CslaveRead(addr + 1);
+}
+
+#if PROF_EN
+static void HarnessProfile()
+{
+    static const char *names[PROF_STAGES] = { "main loop", "I2C handler", "ExpUpdate", "InputGetAxes", "CamUpdateBlobs" };
+    double us = PROF_TICK_NS / 1000.0;
+    uint8_t s;
+    uint8_t i;
+
+    // As a reader on the bus sees them, refreshed every PROF_PUBLISH_MS
+    printf("profiler:    %u interrupts, longest clock stretch %.2f us\n",
+        HarnessReg16(EXP_REG_PROF + PROF_REG_ISRS), HarnessReg16(EXP_REG_PROF + PROF_REG_STRETCH) * us);
+    printf("             %-16s %9s %9s %9s   histogram <2 <4 <8 <16 <32 <64 <128 us, more\n", "stage", "min us", "mean us", "max us");
+    for (s = 0; s < PROF_STAGES; s++)
+    {
+        uint8_t addr = EXP_REG_PROF + PROF_REG_STAGES + s * PROF_STAGE_SIZE;
+
+        if (HarnessReg16(addr + PROF_STAGE_MIN) == 0xFFFF) continue;
+        printf("             %-16s %9.2f %9.2f %9.2f  ", names[s],
+            HarnessReg16(addr + PROF_STAGE_MIN) * us, HarnessReg16(addr + PROF_STAGE_MEAN) * us, HarnessReg16(addr + PROF_STAGE_MAX) * us);
+        for (i = 0; i < PROF_BUCKETS; i++) printf(" %3u", I2CslaveRead(addr + PROF_STAGE_HIST + i));
+        printf("\n");
+    }
+}
+#endif
+
+static void HarnessReport(const WiimoteReport *report)
+{
+    uint16_t age = HarnessReg16(EXP_REG_POLL_AGE);
+
+    // Data read before the poll started made it into this report
+    if (!firstValid && (!waitIMU || (simIMUfirstData && (simIMUfirstData < report->time)))) firstValid = report->time;
+    LatencyReport(report);
+
+    if (!HarnessReg16(EXP_REG_POLL_PER)) return;
+    ageCount++;
+    ageTotal += age;
+    if (age > ageMax) ageMax = age;
+}
+
+void BoardInit(uint8_t mode, uint8_t imu)
+{
+    SimInit();
+    SimGPIOinit();
+    SimADCinit();
+    SimTMRinit();
+    SimNVMinit();
+    SimMSSPinit();
+    if (imu) SimIMUinit();
+
+    memcpy(&simEE[EE_REG_LX_MIN], defaultCal, sizeof(defaultCal));
+
+    // Triggers released, sticks centered
+    SimAnalogSet(LT_CH, 0);
+    SimAnalogSet(RT_CH, 0);
+
+    SimPinSet(ENABLE, mode != MODE_OFF);
+    SimPinSet(MODE, mode != MODE_NUNCHUK);
+}
+
+static void HarnessTrace()
+{
+    uint8_t ring[I2C_TRACE_SIZE];
+    uint8_t head;
+    uint16_t first = 0;
+    uint8_t have = 0;
+    SimTime end;
+    int i;
+
+    // Same as the host sending TRACE_FREEZE, then the Wii Remote pages through the window
+    ExpCmdRcv(TRACE_FREEZE, EXP_REG_CMD);
+    SimRunFor(SIM_TICKS_MS(1));
+    WiimoteTraceRead(ring);
+    end = simTime + SIM_TICKS_MS(100);
+    while (!WiimoteTraceDone() && !SimHalted() && (simTime < end)) SimRunFor(SIM_TICKS_MS(1));
+
+    if (!WiimoteTraceDone())
+    {
+        printf("trace:       not read back\n");
+        return;
+    }
+
+    head = I2CslaveRead(EXP_REG_TRACE_HEAD);
+    for (i = 0; (i < I2C_TRACE_SIZE) && (ring[i] == I2CslaveRead(I2C_TRACE_BASE + i)); i++);
+    printf("trace:       read over the bus, %s the ring, oldest first (us from the first record)\n", (i == I2C_TRACE_SIZE) ? "matches" : "differs from");
+
+    for (i = 0; i < I2C_TRACE_SIZE / 4; i++)
+    {
+        uint8_t *rec = &ring[((head + i) * 4) & (I2C_TRACE_SIZE - 1)];
+        uint16_t t = (rec[2] << 8) | rec[3];
+
+        if (rec[0] == I2C_TRACE_EMPTY) continue;
+        if (!have) first = t;
+        have = 1;
+
+        printf("             %8.0f  ", (uint16_t)(t - first) * 4.0);
+        if (rec[0] == I2C_TRACE_STOP) printf("stop, %u bytes\n", rec[1]);
+        else if (rec[0] & 0x01) printf("read  %02X from %02X\n", rec[0] >> 1, rec[1]);
+        else printf("write %02X to %02X\n", rec[0] >> 1, rec[1]);
+    }
+}
+
+static void Usage()
+{
+    fprintf(stderr,
+        "usage: classicsim [options]\n"
+        "  -m classic|nunchuk|off   controller mode (default classic)\n"
+        "  -t ms                    measured run time (default 1000)\n"
+        "  -w ms                    warm-up excluded from the profile (default 100)\n"
+        "  -n lsb                   peak-to-peak ADC noise (default 0)\n"
+        "  -x                       board without IMU\n"
+        "  -i profile               IMU accelerometer profile stored in EEPROM (default erased)\n"
+        "  -c policy                core clock policy stored in EEPROM: 0 = 32 MHz, 1 = 8 MHz, 2 = adaptive (default erased)\n"
+        "  -e mode                  report refresh mode stored in EEPROM: 0 = auto, 1 = event-driven (default erased)\n"
+        "  -p wii100|wii200|snes|none  Wii Remote polling profile (default wii100)\n"
+        "  -r hz                    override the profile poll rate\n"
+        "  -s file                  input change script (default: built-in, repeated)\n"
+        "  -T                       read back and print the I2C trace at the end\n"
+        "  -q                       summary only\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t mode = MODE_CLASSIC;
+    uint8_t imu = 1;
+    uint8_t quiet = 0;
+    uint8_t trace = 0;
+    uint32_t runMs = 1000;
+    uint32_t warmMs = 100;
+    uint8_t noise = 0;
+    int imuProfile = -1;
+    int clkPolicy = -1;
+    int pollMode = -1;
+    const char *profileName = "wii100";
+    const char *script = NULL;
+    uint32_t pollHz = 0;
+    WiimoteProfile profile;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-m") && (i + 1 < argc))
+        {
+            i++;
+            if (!strcmp(argv[i], "classic")) mode = MODE_CLASSIC;
+            else if (!strcmp(argv[i], "nunchuk")) mode = MODE_NUNCHUK;
+            else if (!strcmp(argv[i], "off")) mode = MODE_OFF;
+            else Usage();
+        }
+        else if (!strcmp(argv[i], "-t") && (i + 1 < argc)) runMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && (i + 1 < argc)) warmMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && (i + 1 < argc)) noise = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p") && (i + 1 < argc)) profileName = argv[++i];
+        else if (!strcmp(argv[i], "-r") && (i + 1 < argc)) pollHz = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && (i + 1 < argc)) script = argv[++i];
+        else if (!strcmp(argv[i], "-x")) imu = 0;
+        else if (!strcmp(argv[i], "-i") && (i + 1 < argc)) imuProfile = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-c") && (i + 1 < argc)) clkPolicy = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-e") && (i + 1 < argc)) pollMode = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-T")) trace = 1;
+        else if (!strcmp(argv[i], "-q")) quiet = 1;
+        else Usage();
+    }
+
+    if (strcmp(profileName, "none"))
+    {
+        if (!WiimoteFindProfile(profileName)) Usage();
+        profile = *WiimoteFindProfile(profileName);
+        if (pollHz) profile.pollHz = pollHz;
+    }
+    else profile.name = NULL;
+
+    if (script)
+    {
+        if (!LatencyLoadScript(script)) return 1;
+    }
+    else LatencyDefaultScript(mode);
+
+    BoardInit(mode, imu);
+    simAnalogNoise = noise;
+    if (imuProfile >= 0) simEE[EE_REG_IMU_CFG] = imuProfile;
+    if (clkPolicy >= 0) simEE[EE_REG_CLK_CFG] = clkPolicy;
+    if (pollMode >= 0) simEE[EE_REG_POLL_CFG] = pollMode;
+    waitIMU = (mode == MODE_NUNCHUK) && imu;
+    if (profile.name) WiimoteInit(&profile, HarnessReport);
+
+    SimRunUntil(SIM_TICKS_MS(warmMs));
+
+    // Measure from the first polled report onwards
+    if (profile.name && (mode != MODE_OFF))
+    {
+        while (!WiimoteIsPolling() && !SimHalted() && (simTime < CONNECT_TIMEOUT)) SimRunFor(SIM_TICKS_MS(1));
+    }
+
+    SimProfileReset();
+    if (profile.name) LatencyStart();
+#if PROF_EN
+    // Same as the host sending PROF_CLR, the firmware clears its statistics on the next pass
+    ExpCmdRcv(PROF_CLR, EXP_REG_CMD);
+#endif
+
+    uint32_t writes[2];
+    uint32_t skips[2];
+    uint32_t writesEnd[2];
+    uint32_t skipsEnd[2];
+
+    uint64_t cycles = simCycles;
+    uint64_t idle = simIdleCycles;
+    I2CreportCounts(writes, skips);
+    SimRunFor(SIM_TICKS_MS(runMs));
+    cycles = simCycles - cycles;
+    idle = simIdleCycles - idle;
+    I2CreportCounts(writesEnd, skipsEnd);
+
+    SimProfile *loop = SimProfileGet("ExpUpdate");
+
+    printf("mode:        %s\n", (mode == MODE_CLASSIC) ? "classic" : (mode == MODE_NUNCHUK) ? "nunchuk" : "off");
+    printf("fosc:        %u Hz\n", SimFosc());
+    printf("simulated:   %u ms (after %u ms warm-up)\n", runMs, warmMs);
+    printf("cycles:      %llu", (unsigned long long)cycles);
+    if (cycles) printf(", %.1f%% idle", 100.0 * idle / cycles);
+    printf("\n");
+    printf("main loop:   %u iterations", loop->calls);
+    if (loop->calls) printf(", %.1f us average", (double)runMs * 1000.0 / loop->calls);
+    printf("\n");
+
+    if (profile.name)
+    {
+        printf("wiimote:     %s, %u Hz poll, %u kHz bus", profile.name, profile.pollHz, profile.busHz / 1000);
+        if (wiimoteStats.connects)
+        {
+            printf(", ID %02X%02X%02X%02X%02X%02X, %s, %u byte reports\n",
+                wiimoteStats.id[0], wiimoteStats.id[1], wiimoteStats.id[2], wiimoteStats.id[3], wiimoteStats.id[4], wiimoteStats.id[5],
+                wiimoteStats.encrypted ? "encrypted" : "unencrypted", wiimoteStats.reportSize);
+            printf("             first report at %.1f ms, ", SIM_US(wiimoteStats.firstReport) / 1000.0);
+            if (firstValid) printf("valid at %.1f ms, ", SIM_US(firstValid) / 1000.0);
+            else printf("never valid, ");
+            printf("%u polls, %u connects, %u bus errors\n", wiimoteStats.polls, wiimoteStats.connects, wiimoteStats.busErrors);
+            printf("i2c:         %u bytes, %u stretches, mean %.1f us, max %.1f us, %u timeouts\n",
+                simI2Cstats.bytes, simI2Cstats.stretches,
+                simI2Cstats.stretches ? SIM_US(simI2Cstats.stretchTotal) / simI2Cstats.stretches : 0.0,
+                SIM_US(simI2Cstats.stretchMax), simI2Cstats.timeouts);
+            printf("             worst case per state (instruction cycles at %u MHz, one bit is %.1f us):\n             ",
+                (unsigned)(ClockGetFreq() / 1000000), 1000000.0 / profile.busHz);
+            for (i = 0; i < SIM_I2C_STATES; i++)
+            {
+                double us = SIM_US(simI2Cstats.stateMax[i]);
+                printf("%s %.1f us (%.0f)%s", stateNames[i], us, us * ClockGetFreq() / 4000000.0, (i < SIM_I2C_STATES - 1) ? ", " : "\n");
+            }
+            printf("poll:        %u us period estimate", HarnessReg16(EXP_REG_POLL_PER));
+            if (ageCount) printf(", sample age at read mean %.0f us, max %u us over %u polls\n", (double)ageTotal / ageCount, ageMax, ageCount);
+            else printf(", not locked\n");
+#if PROF_EN
+            HarnessProfile();
+#endif
+            printf("publish:     expansion %u written, %u unchanged; camera %u written, %u unchanged\n",
+                writesEnd[0] - writes[0], skipsEnd[0] - skips[0], writesEnd[1] - writes[1], skipsEnd[1] - skips[1]);
+            printf("\n");
+            LatencyPrint(stdout);
+        }
+        else printf(", not connected (%u bus errors)\n", wiimoteStats.busErrors);
+    }
+
+    if (trace && WiimoteIsPolling())
+    {
+        printf("\n");
+        HarnessTrace();
+    }
+
+    if (!quiet)
+    {
+        printf("\n");
+        SimProfileReport(stdout);
+    }
+
+    return SimHalted() ? 2 : 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * File:   harness.h
+ * Author: Jackson Snowden
+ */
+
+#ifndef _HARNESS_H_
+#define	_HARNESS_H_
+
+#include <stdint.h>
+
+void BoardInit(uint8_t mode, uint8_t imu);
+
+#endif  /* _HARNESS_H_ */
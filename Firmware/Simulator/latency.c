@@ -0,0 +1,392 @@
+/*
+ * File:   latency.c
+ * Author: Jackson Snowden
+ *
+ * Scripted input changes on the simulated pins and the time until each one
+ * shows up in a report decoded by the Wii Remote model.
+ *
+ * A change counts as seen at the first report that has moved at least half
+ * way from the value before the change to the value the reports settle on.
+ * Changes that never alter the reports (deadzone, disabled input) are
+ * listed as unseen.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "pins.h"
+#include "config.h"
+#include "latency.h"
+
+#define LAT_AXIS        0x20                // Field flag for axes
+#define LAT_INTERVAL    SIM_TICKS_MS(50)    // Default script spacing
+#define LAT_JITTER      SIM_TICKS_MS(20)    // Spread of change times against the poll phase
+#define LAT_BAR_WIDTH   40
+
+typedef struct
+{
+    const char *name;
+    uint8_t field;
+    SimPin pin;
+    uint8_t channel;
+}
+LatInput;
+
+typedef struct
+{
+    SimTime time;
+    uint8_t input;
+    uint16_t value;
+}
+LatStep;
+
+typedef struct
+{
+    SimTime time;
+    uint8_t field;
+    uint8_t before;
+}
+LatChange;
+
+static const LatInput inputs[] =
+{
+    { "A",      WII_BTN_A,      A_PIN },
+    { "B",      WII_BTN_B,      B_PIN },
+    { "X",      WII_BTN_X,      X_PIN },
+    { "Y",      WII_BTN_Y,      Y_PIN },
+    { "DU",     WII_BTN_DU,     DU_PIN },
+    { "DD",     WII_BTN_DD,     DD_PIN },
+    { "DR",     WII_BTN_DR,     DR_PIN },
+    { "DL",     WII_BTN_DL,     DL_PIN },
+    { "R",      WII_BTN_R,      R_PIN },
+    { "ZR",     WII_BTN_ZR,     ZR_PIN },
+    { "L",      WII_BTN_L,      L_PIN },
+    { "ZL",     WII_BTN_ZL,     ZL_PIN },
+    { "PLUS",   WII_BTN_PLUS,   PLUS_PIN },
+    { "MINUS",  WII_BTN_MINUS,  MINUS_PIN },
+    { "HOME",   WII_BTN_HOME,   HOME_PIN },
+    { "C",      WII_BTN_C,      C_PIN },
+    { "Z",      WII_BTN_Z,      Z_PIN },
+    { "LX",     LAT_AXIS | WII_AX_LX,   LX_PIN, LX_CH },
+    { "LY",     LAT_AXIS | WII_AX_LY,   LY_PIN, LY_CH },
+    { "RX",     LAT_AXIS | WII_AX_RX,   RX_PIN, RX_CH },
+    { "RY",     LAT_AXIS | WII_AX_RY,   RY_PIN, RY_CH },
+    { "LT",     LAT_AXIS | WII_AX_LT,   LT_PIN, LT_CH },
+    { "RT",     LAT_AXIS | WII_AX_RT,   RT_PIN, RT_CH },
+    { NULL }
+};
+
+// Default scripts, repeated with jittered spacing
+static const char *classicScript[] = { "A 1", "A 0", "LX 1023", "LX 512", "DU 1", "DU 0", "RY 0", "RY 512", NULL };
+static const char *nunchukScript[] = { "Z 1", "Z 0", "LX 1023", "LX 512", "C 1", "C 0", "LY 0", "LY 512", NULL };
+
+static LatStep *steps;
+static uint32_t stepCount;
+static uint8_t repeat;
+
+static LatChange *changes;
+static uint32_t changeCount;
+static uint32_t changeSize;
+
+static WiimoteReport *reports;
+static uint32_t reportCount;
+static uint32_t reportSize;
+
+static uint8_t started;
+static WiimoteReport last;
+static uint16_t jitterState = 0x5EED;
+
+// - - - - - - - - - - //
+
+static int8_t LatFindInput(const char *name)
+{
+    int8_t i;
+
+    for (i = 0; inputs[i].name; i++)
+    {
+        if (!strcasecmp(inputs[i].name, name)) return i;
+    }
+
+    return -1;
+}
+
+static uint8_t LatAddStep(SimTime time, const char *name, long value)
+{
+    int8_t input = LatFindInput(name);
+
+    if (input < 0) return 0;
+
+    steps = realloc(steps, (stepCount + 1) * sizeof(LatStep));
+    steps[stepCount].time = time;
+    steps[stepCount].input = input;
+    steps[stepCount].value = value;
+    stepCount++;
+    return 1;
+}
+
+uint8_t LatencyLoadScript(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[128];
+    uint32_t n = 0;
+
+    if (!f)
+    {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 0;
+    }
+
+    stepCount = 0;
+    repeat = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        double ms;
+        char name[16];
+        long value;
+        char *comment = strchr(line, '#');
+
+        n++;
+        if (comment) *comment = 0;
+        if (strspn(line, " \t\r\n") == strlen(line)) continue;
+
+        if ((sscanf(line, "%lf %15s %ld", &ms, name, &value) != 3) || (ms < 0) || !LatAddStep(SIM_TICKS_US(ms * 1000.0), name, value))
+        {
+            fprintf(stderr, "%s:%u: expected '<ms> <input> <value>'\n", path, n);
+            fclose(f);
+            return 0;
+        }
+    }
+
+    fclose(f);
+    return 1;
+}
+
+void LatencyDefaultScript(uint8_t mode)
+{
+    const char **script = (mode == MODE_NUNCHUK) ? nunchukScript : classicScript;
+    uint8_t i;
+
+    stepCount = 0;
+    repeat = 1;
+
+    for (i = 0; script[i]; i++)
+    {
+        char name[16];
+        long value;
+
+        sscanf(script[i], "%15s %ld", name, &value);
+        LatAddStep(0, name, value);
+    }
+}
+
+// - - - - - - - - - - //
+
+static uint8_t LatField(const WiimoteReport *r, uint8_t field)
+{
+    if (field & LAT_AXIS) return r->axis[field & ~LAT_AXIS];
+    return (r->buttons >> field) & 1;
+}
+
+static void LatApply(const LatStep *step)
+{
+    const LatInput *in = &inputs[step->input];
+
+    // Buttons pull their pin low
+    if (in->field & LAT_AXIS) SimAnalogSet(in->channel, step->value > 1023 ? 1023 : step->value);
+    else SimPinSet(in->pin, !step->value);
+
+    if (changeCount == changeSize)
+    {
+        changeSize = changeSize ? 2 * changeSize : 64;
+        changes = realloc(changes, changeSize * sizeof(LatChange));
+    }
+
+    changes[changeCount].time = simTime;
+    changes[changeCount].field = in->field;
+    changes[changeCount].before = LatField(&last, in->field);
+    changeCount++;
+}
+
+static void LatencyMain(void *arg)
+{
+    SimTime start = simTime;
+    SimTime next = simTime;
+    uint32_t i = 0;
+
+    while (i < stepCount)
+    {
+        if (repeat)
+        {
+            jitterState = (jitterState >> 1) ^ (-(jitterState & 1) & 0xB400);
+            next += LAT_INTERVAL + (jitterState % LAT_JITTER);
+        }
+        else next = start + steps[i].time;
+
+        SimWaitUntil(next);
+        LatApply(&steps[i]);
+
+        i++;
+        if (repeat && (i == stepCount)) i = 0;
+    }
+}
+
+void LatencyStart()
+{
+    started = 1;
+    if (stepCount) SimThreadCreate(LatencyMain, NULL);
+}
+
+void LatencyReport(const WiimoteReport *report)
+{
+    last = *report;
+    if (!started) return;
+
+    if (reportCount == reportSize)
+    {
+        reportSize = reportSize ? 2 * reportSize : 1024;
+        reports = realloc(reports, reportSize * sizeof(WiimoteReport));
+    }
+
+    reports[reportCount++] = *report;
+}
+
+// - - - - - - - - - - //
+
+static int LatCompare(const void *a, const void *b)
+{
+    SimTime x = *(const SimTime *)a;
+    SimTime y = *(const SimTime *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint8_t LatMeasure(uint32_t c, SimTime *latency)
+{
+    const LatChange *ch = &changes[c];
+    SimTime end = (SimTime)-1;
+    uint32_t first;
+    uint32_t r;
+    int16_t settled = -1;
+    uint32_t i;
+
+    // Window ends at the next change of the same input
+    for (i = c + 1; i < changeCount; i++)
+    {
+        if (changes[i].field == ch->field)
+        {
+            end = changes[i].time;
+            break;
+        }
+    }
+
+    for (first = 0; (first < reportCount) && (reports[first].time < ch->time); first++);
+
+    for (r = first; (r < reportCount) && (reports[r].time < end); r++) settled = LatField(&reports[r], ch->field);
+
+    if ((settled < 0) || (settled == ch->before)) return 0;
+
+    for (r = first; (r < reportCount) && (reports[r].time < end); r++)
+    {
+        int16_t moved = (int16_t)LatField(&reports[r], ch->field) - ch->before;
+        int16_t total = settled - ch->before;
+
+        if ((2 * moved * (total > 0 ? 1 : -1)) >= (total > 0 ? total : -total))
+        {
+            *latency = reports[r].time - ch->time;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void LatPrintRow(FILE *out, const char *label, SimTime *lat, uint32_t seen, uint32_t total)
+{
+    double sum = 0;
+    uint32_t i;
+
+    fprintf(out, "  %-8s %4u/%-4u seen", label, seen, total);
+
+    if (seen)
+    {
+        qsort(lat, seen, sizeof(SimTime), LatCompare);
+        for (i = 0; i < seen; i++) sum += SIM_US(lat[i]);
+
+        fprintf(out, "   min %6.2f  mean %6.2f  p50 %6.2f  p95 %6.2f  max %6.2f ms",
+            SIM_US(lat[0]) / 1000.0,
+            sum / seen / 1000.0,
+            SIM_US(lat[seen / 2]) / 1000.0,
+            SIM_US(lat[(seen * 95) / 100]) / 1000.0,
+            SIM_US(lat[seen - 1]) / 1000.0);
+    }
+
+    fprintf(out, "\n");
+}
+
+void LatencyPrint(FILE *out)
+{
+    SimTime *buttons = malloc((changeCount + 1) * sizeof(SimTime));
+    SimTime *axes = malloc((changeCount + 1) * sizeof(SimTime));
+    SimTime *all = malloc((changeCount + 1) * sizeof(SimTime));
+    uint32_t nButtons = 0;
+    uint32_t nAxes = 0;
+    uint32_t seenButtons = 0;
+    uint32_t seenAxes = 0;
+    uint32_t seen = 0;
+    uint32_t hist[64];
+    uint32_t peak = 0;
+    uint32_t top = 0;
+    uint32_t i;
+
+    for (i = 0; i < changeCount; i++)
+    {
+        SimTime lat;
+        uint8_t ok = LatMeasure(i, &lat);
+
+        if (changes[i].field & LAT_AXIS)
+        {
+            nAxes++;
+            if (ok) axes[seenAxes++] = lat;
+        }
+        else
+        {
+            nButtons++;
+            if (ok) buttons[seenButtons++] = lat;
+        }
+
+        if (ok) all[seen++] = lat;
+    }
+
+    fprintf(out, "latency:     input change to decoded report, %u reports\n", reportCount);
+    LatPrintRow(out, "buttons", buttons, seenButtons, nButtons);
+    LatPrintRow(out, "axes", axes, seenAxes, nAxes);
+    LatPrintRow(out, "all", all, seen, changeCount);
+
+    if (seen)
+    {
+        // 1 ms buckets, the last one collects everything above
+        memset(hist, 0, sizeof(hist));
+        for (i = 0; i < seen; i++)
+        {
+            uint32_t b = SIM_US(all[i]) / 1000.0;
+            if (b > 63) b = 63;
+            hist[b]++;
+            if (b > top) top = b;
+        }
+        for (i = 0; i <= top; i++) if (hist[i] > peak) peak = hist[i];
+
+        fprintf(out, "\n  ms\n");
+        for (i = SIM_US(all[0]) / 1000.0; i <= top; i++)
+        {
+            uint32_t w = (hist[i] * LAT_BAR_WIDTH + peak - 1) / peak;
+
+            fprintf(out, "  %2u%s %-*.*s %u\n", i, (i == 63) ? "+" : " ", LAT_BAR_WIDTH, w,
+                "########################################", hist[i]);
+        }
+    }
+
+    free(buttons);
+    free(axes);
+    free(all);
+}
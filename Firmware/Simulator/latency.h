@@ -0,0 +1,25 @@
+/*
+ * File:   latency.h
+ * Author: Jackson Snowden
+ */
+
+#ifndef _LATENCY_H_
+#define	_LATENCY_H_
+
+#include <stdio.h>
+#include "wiimote.h"
+
+// Script file format, one change per line:
+//   <ms after start> <input> <value>
+// Buttons take 1 (pressed) or 0, axes take a 10-bit level. '#' starts a comment.
+uint8_t LatencyLoadScript(const char *path);
+
+void LatencyDefaultScript(uint8_t mode);
+
+void LatencyStart();
+
+void LatencyReport(const WiimoteReport *report);
+
+void LatencyPrint(FILE *out);
+
+#endif  /* _LATENCY_H_ */
@@ -0,0 +1,109 @@
+/*
+ * File:   periph.h
+ * Author: Jackson Snowden
+ */
+
+#ifndef _PERIPH_H_
+#define	_PERIPH_H_
+
+#include "sim.h"
+
+// Pin descriptor, see pins.h
+typedef struct
+{
+    uint8_t port;
+    uint8_t bit;
+}
+SimPin;
+
+typedef void (*SimPinHook)(uint8_t port, uint8_t bit, uint8_t level);
+
+#define SIM_ADC_CHANNELS    64
+
+extern uint8_t simPinIn[5];
+extern uint16_t simAnalog[SIM_ADC_CHANNELS];
+extern uint8_t simAnalogNoise;
+
+// GPIO
+void SimGPIOinit();
+
+void SimPinSet(SimPin pin, uint8_t level);
+
+uint8_t SimPinGet(SimPin pin);
+
+void SimOnPinOutput(SimPinHook hook);
+
+// ADCC
+void SimADCinit();
+
+void SimAnalogSet(uint8_t channel, uint16_t value);
+
+// ADACT auto-conversion trigger sources
+#define SIM_ADACT_TMR2  0x04
+#define SIM_ADACT_TMR4  0x05
+
+void SimADCtrigger(uint8_t source);
+
+// Timers
+void SimTMRinit();
+
+// Data EEPROM
+#define SIM_EE_SIZE     256
+
+extern uint8_t simEE[SIM_EE_SIZE];
+
+void SimNVMinit();
+
+// MSSP1 I2C slave, driven by a bus master thread
+#define SIM_I2C_WRITE_ADDR  0
+#define SIM_I2C_WRITE_DATA  1
+#define SIM_I2C_READ_ADDR   2
+#define SIM_I2C_READ_DATA   3
+#define SIM_I2C_STATES      4
+
+typedef struct
+{
+    uint32_t bytes;
+    uint32_t stretches;
+    SimTime stretchTotal;
+    SimTime stretchMax;
+    SimTime stateMax[SIM_I2C_STATES];  // Longest stretch after each kind of byte
+    uint32_t timeouts;
+}
+SimI2Cstats;
+
+extern SimI2Cstats simI2Cstats;
+
+void SimMSSPinit();
+
+void SimI2CsetClock(uint32_t hz);
+
+void SimI2Cstart();
+
+uint8_t SimI2Cwrite(uint8_t data);
+
+uint8_t SimI2Cread(uint8_t ack);
+
+void SimI2Cstop();
+
+// MSSP2 SPI master, connected to one slave device
+typedef struct
+{
+    void (*select)(uint8_t active);
+    uint8_t (*transfer)(uint8_t mosi);
+}
+SimSPIdevice;
+
+void SimSPIattach(const SimSPIdevice *dev, SimPin cs);
+
+// LSM6DS3 accelerometer/gyroscope
+void SimIMUinit();
+
+void SimIMUsetAccel(int16_t x, int16_t y, int16_t z);
+
+extern uint8_t simIMUnoise;
+
+// Time the firmware first read accelerometer data, 0 until then
+extern SimTime simIMUfirstData;
+
+#endif  /* _PERIPH_H_ */
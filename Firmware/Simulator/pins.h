@@ -0,0 +1,56 @@
+/*
+ * File:   pins.h
+ * Author: Jackson Snowden
+ *
+ * Expands the firmware pin names in pin_defs.h into simulator pin
+ * descriptors so the harness and the firmware share one pin map.
+ */
+
+#ifndef _PINS_H_
+#define	_PINS_H_
+
+#include "periph.h"
+
+#define SIM_PIN(p, b)   ((SimPin){ SIM_PORT##p, b })
+
+#define RA0     SIM_PIN(A, 0)
+#define RA1     SIM_PIN(A, 1)
+#define RA2     SIM_PIN(A, 2)
+#define RA3     SIM_PIN(A, 3)
+#define RA4     SIM_PIN(A, 4)
+#define RA5     SIM_PIN(A, 5)
+#define RA6     SIM_PIN(A, 6)
+#define RA7     SIM_PIN(A, 7)
+#define RB0     SIM_PIN(B, 0)
+#define RB1     SIM_PIN(B, 1)
+#define RB2     SIM_PIN(B, 2)
+#define RB3     SIM_PIN(B, 3)
+#define RB4     SIM_PIN(B, 4)
+#define RB5     SIM_PIN(B, 5)
+#define RC0     SIM_PIN(C, 0)
+#define RC1     SIM_PIN(C, 1)
+#define RC2     SIM_PIN(C, 2)
+#define RC3     SIM_PIN(C, 3)
+#define RC4     SIM_PIN(C, 4)
+#define RC5     SIM_PIN(C, 5)
+#define RC6     SIM_PIN(C, 6)
+#define RC7     SIM_PIN(C, 7)
+#define RD0     SIM_PIN(D, 0)
+#define RD1     SIM_PIN(D, 1)
+#define RD2     SIM_PIN(D, 2)
+#define RD3     SIM_PIN(D, 3)
+#define RD4     SIM_PIN(D, 4)
+#define RD5     SIM_PIN(D, 5)
+#define RD6     SIM_PIN(D, 6)
+#define RD7     SIM_PIN(D, 7)
+#define RE0     SIM_PIN(E, 0)
+#define RE1     SIM_PIN(E, 1)
+#define RE2     SIM_PIN(E, 2)
+#define LATB0   SIM_PIN(B, 0)
+#define LATB1   SIM_PIN(B, 1)
+#define LATB2   SIM_PIN(B, 2)
+#define LATB5   SIM_PIN(B, 5)
+
+#include "pin_defs.h"
+
+#endif  /* _PINS_H_ */
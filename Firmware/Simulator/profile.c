@@ -0,0 +1,235 @@
+/*
+ * File:   profile.c
+ * Author: Jackson Snowden
+ *
+ * Function-level cycle profiler for firmware built with
+ * -finstrument-functions. Each call is charged SIM_CALL_CYCLES plus the
+ * routine's entry in costTable, which covers code whose cost is dominated by
+ * arithmetic the host executes for free (XC8 long multiply/divide helpers).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include "sim.h"
+
+#define PROFILE_SLOTS   512
+#define PROFILE_DEPTH   64
+
+typedef struct
+{
+    uintptr_t addr;
+    const char *name;
+}
+Symbol;
+
+typedef struct
+{
+    void *fn;
+    SimProfile *prof;
+}
+Slot;
+
+typedef struct
+{
+    SimProfile *prof;
+    uint64_t start;
+}
+Frame;
+
+// Estimated self cost in instruction cycles on top of the call overhead
+static const struct { const char *name; uint32_t cost; } costTable[] =
+{
+    { "Map",            1100 },     // __lmul + __lldiv
+    { "Encrypt",          16 },
+    { "Decrypt",          16 },
+    { "GenEncryption",  4000 },
+};
+
+static Symbol *symbols;
+static uint32_t symbolCount;
+static uint8_t symbolsLoaded;
+
+static Slot slots[PROFILE_SLOTS];
+static SimProfile profiles[PROFILE_SLOTS];
+static uint32_t profileCount;
+
+static Frame stack[PROFILE_DEPTH];
+static uint32_t depth;
+
+void __cyg_profile_func_enter(void *fn, void *site) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void *fn, void *site) __attribute__((no_instrument_function));
+
+static void LoadSymbols()
+{
+    FILE *f;
+    long size;
+    uint8_t *image;
+    Elf64_Ehdr *eh;
+    Elf64_Shdr *sh;
+    uintptr_t bias = 0;
+    uint32_t i;
+    uint32_t j;
+
+    symbolsLoaded = 1;
+
+    f = fopen("/proc/self/exe", "rb");
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    image = malloc(size);
+    if (fread(image, 1, size, f) != (size_t)size) size = 0;
+    fclose(f);
+    if (size < (long)sizeof(Elf64_Ehdr)) return;
+
+    eh = (Elf64_Ehdr*)image;
+    sh = (Elf64_Shdr*)(image + eh->e_shoff);
+
+    for (i = 0; i < eh->e_shnum; i++)
+    {
+        if (sh[i].sh_type != SHT_SYMTAB) continue;
+
+        Elf64_Sym *sym = (Elf64_Sym*)(image + sh[i].sh_offset);
+        const char *str = (const char*)(image + sh[sh[i].sh_link].sh_offset);
+        uint32_t n = sh[i].sh_size / sizeof(Elf64_Sym);
+
+        symbols = malloc(n * sizeof(Symbol));
+
+        for (j = 0; j < n; j++)
+        {
+            if (ELF64_ST_TYPE(sym[j].st_info) != STT_FUNC || !sym[j].st_value) continue;
+
+            // Position-independent builds are relocated by a constant bias
+            if (!strcmp(str + sym[j].st_name, "SimInit")) bias = (uintptr_t)&SimInit - sym[j].st_value;
+
+            symbols[symbolCount].addr = sym[j].st_value;
+            symbols[symbolCount].name = str + sym[j].st_name;
+            symbolCount++;
+        }
+    }
+
+    for (i = 0; i < symbolCount; i++) symbols[i].addr += bias;
+}
+
+static SimProfile *Lookup(void *fn)
+{
+    uint32_t h = ((uintptr_t)fn >> 4) % PROFILE_SLOTS;
+    uint32_t i;
+
+    while (slots[h].fn && (slots[h].fn != fn)) h = (h + 1) % PROFILE_SLOTS;
+    if (slots[h].fn) return slots[h].prof;
+
+    if (!symbolsLoaded) LoadSymbols();
+
+    SimProfile *p = &profiles[profileCount++];
+    p->name = "?";
+    p->min = 0xFFFFFFFF;
+    p->cost = SIM_CALL_CYCLES;
+
+    for (i = 0; i < symbolCount; i++)
+    {
+        if (symbols[i].addr == (uintptr_t)fn)
+        {
+            p->name = symbols[i].name;
+            break;
+        }
+    }
+
+    for (i = 0; i < sizeof(costTable) / sizeof(costTable[0]); i++)
+    {
+        if (!strcmp(costTable[i].name, p->name)) p->cost += costTable[i].cost;
+    }
+
+    slots[h].fn = fn;
+    slots[h].prof = p;
+    return p;
+}
+
+void __cyg_profile_func_enter(void *fn, void *site)
+{
+    SimProfile *p = Lookup(fn);
+
+    if (depth < PROFILE_DEPTH)
+    {
+        stack[depth].prof = p;
+        stack[depth].start = simCycles;
+    }
+    depth++;
+
+    SimCycles(p->cost);
+}
+
+void __cyg_profile_func_exit(void *fn, void *site)
+{
+    if (depth == 0) return;
+    depth--;
+    if (depth >= PROFILE_DEPTH) return;
+
+    SimProfile *p = stack[depth].prof;
+    uint32_t cycles = simCycles - stack[depth].start;
+
+    p->calls++;
+    p->total += cycles;
+    if (cycles < p->min) p->min = cycles;
+    if (cycles > p->max) p->max = cycles;
+}
+
+// - - - - - - - - - - //
+
+void SimProfileReset()
+{
+    uint32_t i;
+
+    for (i = 0; i < profileCount; i++)
+    {
+        profiles[i].calls = 0;
+        profiles[i].total = 0;
+        profiles[i].min = 0xFFFFFFFF;
+        profiles[i].max = 0;
+    }
+}
+
+SimProfile *SimProfileGet(const char *name)
+{
+    static SimProfile none = { "?", 0, 0, 0, 0, 0 };
+    uint32_t i;
+
+    for (i = 0; i < profileCount; i++)
+    {
+        if (!strcmp(profiles[i].name, name)) return &profiles[i];
+    }
+
+    return &none;
+}
+
+static int CompareTotal(const void *a, const void *b)
+{
+    const SimProfile *pa = *(const SimProfile**)a;
+    const SimProfile *pb = *(const SimProfile**)b;
+
+    if (pa->total < pb->total) return 1;
+    if (pa->total > pb->total) return -1;
+    return strcmp(pa->name, pb->name);
+}
+
+void SimProfileReport(FILE *out)
+{
+    SimProfile *sorted[PROFILE_SLOTS];
+    uint32_t n = 0;
+    uint32_t i;
+
+    for (i = 0; i < profileCount; i++)
+    {
+        if (profiles[i].calls) sorted[n++] = &profiles[i];
+    }
+    qsort(sorted, n, sizeof(SimProfile*), CompareTotal);
+
+    fprintf(out, "%-24s %10s %14s %10s %10s %10s\n", "function", "calls", "cycles", "avg", "min", "max");
+    for (i = 0; i < n; i++)
+    {
+        SimProfile *p = sorted[i];
+        fprintf(out, "%-24s %10u %14llu %10llu %10u %10u\n", p->name, p->calls,
+                (unsigned long long)p->total, (unsigned long long)(p->total / p->calls), p->min, p->max);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * File:   sfr.h
+ * Author: Jackson Snowden
+ */
+
+#ifndef _SFR_H_
+#define	_SFR_H_
+
+// Special function registers modelled by the simulator
+#define SIM_SFR_LIST(X) \
+    X(PORTA) X(PORTB) X(PORTC) X(PORTD) X(PORTE) \
+    X(LATA) X(LATB) X(LATC) X(LATD) X(LATE) \
+    X(TRISA) X(TRISB) X(TRISC) X(TRISD) X(TRISE) \
+    X(ANSELA) X(ANSELB) X(ANSELC) X(ANSELD) X(ANSELE) \
+    X(WPUA) X(WPUB) X(WPUC) X(WPUD) X(WPUE) \
+    X(IOCAP) X(IOCAN) X(IOCAF) X(IOCBP) X(IOCBN) X(IOCBF) \
+    X(IOCCP) X(IOCCN) X(IOCCF) X(IOCEP) X(IOCEN) X(IOCEF) \
+    X(INTCON) \
+    X(PIR0) X(PIR1) X(PIR2) X(PIR3) X(PIR4) X(PIR5) X(PIR6) X(PIR7) X(PIR8) \
+    X(PIE0) X(PIE1) X(PIE2) X(PIE3) X(PIE4) X(PIE5) X(PIE6) X(PIE7) X(PIE8) \
+    X(OSCCON1) X(OSCCON2) X(OSCCON3) X(OSCSTAT) X(OSCFRQ) X(CPUDOZE) \
+    X(PPSLOCK) X(SSP1DATPPS) X(SSP1CLKPPS) X(SSP2DATPPS) \
+    X(RB0PPS) X(RB1PPS) X(RB2PPS) X(RB3PPS) X(RB4PPS) \
+    X(ADCON0) X(ADCON1) X(ADCON2) X(ADCON3) X(ADCLK) X(ADREF) \
+    X(ADPRE) X(ADACQ) X(ADCAP) X(ADPCH) X(ADRPT) X(ADCNT) X(ADSTAT) X(ADACT) \
+    X(ADRESH) X(ADRESL) X(ADPREVH) X(ADPREVL) X(ADACCU) X(ADACCH) X(ADACCL) \
+    X(ADFLTRH) X(ADFLTRL) X(ADSTPTH) X(ADSTPTL) X(ADERRH) X(ADERRL) \
+    X(ADLTHH) X(ADLTHL) X(ADUTHH) X(ADUTHL) \
+    X(NVMCON1) X(NVMCON2) X(NVMADRH) X(NVMADRL) X(NVMDATH) X(NVMDATL) \
+    X(SSP1BUF) X(SSP1ADD) X(SSP1MSK) X(SSP1STAT) X(SSP1CON1) X(SSP1CON2) X(SSP1CON3) \
+    X(SSP2BUF) X(SSP2ADD) X(SSP2MSK) X(SSP2STAT) X(SSP2CON1) X(SSP2CON2) X(SSP2CON3) \
+    X(T1CON) X(T1GCON) X(T1CLK) X(TMR1H) X(TMR1L) \
+    X(T3CON) X(T3GCON) X(T3CLK) X(TMR3H) X(TMR3L) \
+    X(T2TMR) X(T2PR) X(T2CON) X(T2HLT) X(T2CLKCON) X(T2RST) \
+    X(T4TMR) X(T4PR) X(T4CON) X(T4HLT) X(T4CLKCON) X(T4RST)
+
+#define SIM_SFR_ENUM(r) SFR_##r,
+
+enum
+{
+    SIM_SFR_LIST(SIM_SFR_ENUM)
+    SFR_COUNT
+};
+
+#endif  /* _SFR_H_ */
@@ -0,0 +1,462 @@
+/*
+ * File:   sim.c
+ * Author: Jackson Snowden
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "sim.h"
+
+#define SIM_SFR_NAME(r) #r,
+
+#define SIM_STACK_SIZE  (256 * 1024)
+
+struct SimThread
+{
+    ucontext_t ctx;
+    ucontext_t *caller;
+    SimThreadFn fn;
+    void *arg;
+    char *stack;
+    uint8_t signalled;
+    uint8_t done;
+};
+
+typedef struct SimEvent
+{
+    SimTime when;
+    SimEventFn fn;
+    void *arg;
+    struct SimEvent *next;
+}
+SimEvent;
+
+volatile uint8_t simSFR[SFR_COUNT];
+const char *simSFRname[SFR_COUNT] = { SIM_SFR_LIST(SIM_SFR_NAME) };
+
+SimTime simTime;
+uint64_t simCycles;
+uint64_t simIdleCycles;
+
+static SimSyncHook syncHook[SFR_COUNT];
+static SimWriteHook writeHook[SFR_COUNT];
+static SimSyncHook readHook[SFR_COUNT];
+
+// Most recent firmware access, committed before the next one
+static int16_t pendReg = -1;
+static uint8_t pendVal;
+static uint8_t pendBuf;
+static volatile uint16_t bufSlot;
+
+static SimEvent *events;
+static SimEvent *eventPool;
+
+static ucontext_t harnessCtx;
+static SimThread fwThread;
+static SimThread *current;
+static uint8_t fwStarted;
+static uint8_t halted;
+static uint8_t inIsr;
+static SimTime stopTime;
+
+extern void FirmwareMain();
+extern void ISR();
+
+void SimInit()
+{
+    memset((void*)simSFR, 0, sizeof(simSFR));
+
+    // Power-on reset values
+    simSFR[SFR_TRISA] = 0xFF;
+    simSFR[SFR_TRISB] = 0xFF;
+    simSFR[SFR_TRISC] = 0xFF;
+    simSFR[SFR_TRISD] = 0xFF;
+    simSFR[SFR_TRISE] = 0x0F;
+    simSFR[SFR_ANSELA] = 0xFF;
+    simSFR[SFR_ANSELB] = 0xFF;
+    simSFR[SFR_ANSELC] = 0xFF;
+    simSFR[SFR_ANSELD] = 0xFF;
+    simSFR[SFR_ANSELE] = 0x07;
+    simSFR[SFR_OSCCON1] = 0x60;     // HFINTOSC, NDIV = 1:1 (RSTOSC = HFINT32)
+    simSFR[SFR_OSCFRQ] = 0x06;      // 32 MHz
+    simSFR[SFR_SSP1MSK] = 0xFF;
+    simSFR[SFR_SSP2MSK] = 0xFF;
+
+    simTime = 0;
+    simCycles = 0;
+    pendReg = -1;
+}
+
+void SimOnSync(uint8_t reg, SimSyncHook hook)
+{
+    syncHook[reg] = hook;
+}
+
+void SimOnWrite(uint8_t reg, SimWriteHook hook)
+{
+    writeHook[reg] = hook;
+}
+
+void SimOnRead(uint8_t reg, SimSyncHook hook)
+{
+    readHook[reg] = hook;
+}
+
+SimTime SimTicksPerCycle()
+{
+    // One instruction cycle is four FOSC periods, FOSC = HFINTOSC / 2^NDIV
+    uint8_t ndiv = simSFR[SFR_OSCCON1] & 0x0F;
+    if (ndiv > 9) ndiv = 9;
+    return (SimTime)4 << ndiv;
+}
+
+uint32_t SimFosc()
+{
+    return (uint32_t)(SIM_HFINTOSC * 4 / SimTicksPerCycle());
+}
+
+// - - - - - - - - - - //
+
+void SimCommit()
+{
+    if (pendReg < 0) return;
+
+    uint8_t reg = pendReg;
+    pendReg = -1;
+
+    if (pendBuf)
+    {
+        // Bit 8 of the buffer slot survives reads and is cleared by any store
+        if (bufSlot & 0x100)
+        {
+            if (readHook[reg]) readHook[reg](reg);
+        }
+        else
+        {
+            uint8_t old = simSFR[reg];
+            simSFR[reg] = bufSlot & 0xFF;
+            if (writeHook[reg]) writeHook[reg](reg, old);
+        }
+    }
+    else if ((simSFR[reg] != pendVal) && writeHook[reg]) writeHook[reg](reg, pendVal);
+}
+
+volatile uint8_t *SimAccess(uint8_t reg)
+{
+    SimCycles(SIM_ACCESS_CYCLES);
+    if (syncHook[reg]) syncHook[reg](reg);
+
+    pendReg = reg;
+    pendVal = simSFR[reg];
+    pendBuf = 0;
+
+    return &simSFR[reg];
+}
+
+volatile uint16_t *SimAccessBuf(uint8_t reg)
+{
+    SimCycles(SIM_ACCESS_CYCLES);
+    if (syncHook[reg]) syncHook[reg](reg);
+
+    pendReg = reg;
+    pendBuf = 1;
+    bufSlot = 0x100 | simSFR[reg];
+
+    return &bufSlot;
+}
+
+void SimDelay(uint32_t cycles)
+{
+    SimCycles(cycles);
+}
+
+static uint8_t SimWakePending()
+{
+    uint8_t i;
+
+    // Any enabled flag wakes the core, whether or not GIE lets it interrupt
+    if (simSFR[SFR_PIR0] & simSFR[SFR_PIE0] & 0x31) return 1;
+    for (i = 1; i <= 8; i++)
+    {
+        if (simSFR[SFR_PIR0 + i] & simSFR[SFR_PIE0 + i]) return 1;
+    }
+
+    return 0;
+}
+
+void SimSleep()
+{
+    uint64_t start;
+
+    // Only Idle is modelled: peripherals keep their clocks and time runs on
+    // at the core clock until an interrupt flag wakes it
+    SimCycles(1);
+    start = simCycles;
+    while (!SimWakePending() && !halted)
+    {
+        SimTime step = events ? events->when : simTime;
+        uint32_t cycles = 1;
+
+        if (step > simTime) cycles = (step - simTime + SimTicksPerCycle() - 1) / SimTicksPerCycle();
+        SimCycles(cycles);
+    }
+    simIdleCycles += simCycles - start;
+}
+
+void SimJump(uint16_t addr)
+{
+    SimCommit();
+    fprintf(stderr, "[%10.1f us] firmware jumped to 0x%04X\n", SIM_US(simTime), addr);
+
+    // Nothing past the application is simulated, park the core
+    simSFR[SFR_INTCON] = 0;
+    halted = 1;
+    while (1) SimCycles(1000);
+}
+
+// - - - - - - - - - - //
+
+void SimSchedule(SimTime when, SimEventFn fn, void *arg)
+{
+    SimEvent *ev;
+    SimEvent **pos;
+
+    if (eventPool)
+    {
+        ev = eventPool;
+        eventPool = ev->next;
+    }
+    else ev = malloc(sizeof(SimEvent));
+
+    ev->when = when;
+    ev->fn = fn;
+    ev->arg = arg;
+
+    // Keep FIFO order between events due at the same time
+    pos = &events;
+    while (*pos && ((*pos)->when <= when)) pos = &(*pos)->next;
+    ev->next = *pos;
+    *pos = ev;
+}
+
+void SimCancel(SimEventFn fn, void *arg)
+{
+    SimEvent **pos = &events;
+
+    while (*pos)
+    {
+        SimEvent *ev = *pos;
+        if ((ev->fn == fn) && (ev->arg == arg))
+        {
+            *pos = ev->next;
+            ev->next = eventPool;
+            eventPool = ev;
+        }
+        else pos = &ev->next;
+    }
+}
+
+static uint8_t SimIrqPending()
+{
+    uint8_t intcon = simSFR[SFR_INTCON];
+    uint8_t i;
+
+    if (!(intcon & 0x80)) return 0;
+
+    // PIR0 sources do not depend on PEIE
+    if (simSFR[SFR_PIR0] & simSFR[SFR_PIE0] & 0x31) return 1;
+    if (!(intcon & 0x40)) return 0;
+
+    for (i = 1; i <= 8; i++)
+    {
+        if (simSFR[SFR_PIR0 + i] & simSFR[SFR_PIE0 + i]) return 1;
+    }
+
+    return 0;
+}
+
+static void SimInterrupt()
+{
+    inIsr = 1;
+    simSFR[SFR_INTCON] &= 0x7F;
+    SimCycles(SIM_IRQ_CYCLES);
+    ISR();
+    SimCommit();
+    simSFR[SFR_INTCON] |= 0x80;
+    inIsr = 0;
+}
+
+static void SimService(SimTime until)
+{
+    while (1)
+    {
+        SimTime limit = until;
+        uint8_t fw = (current == &fwThread);
+
+        // Stop part way through long steps such as __delay_ms()
+        if (fw && (stopTime < limit)) limit = (stopTime > simTime) ? stopTime : simTime;
+
+        // Dispatch everything due before the end of this step in time order,
+        // stopping early if an event raises an interrupt the core would take
+        while (events && (events->when <= limit))
+        {
+            SimEvent *ev = events;
+            events = ev->next;
+            if (ev->when > simTime) simTime = ev->when;
+            ev->fn(ev->arg);
+            ev->next = eventPool;
+            eventPool = ev;
+
+            if (!inIsr && fw && SimIrqPending()) break;
+        }
+
+        if (!inIsr && fw && SimIrqPending())
+        {
+            // Interrupt cycles extend the current step
+            SimTime start = simTime;
+            SimInterrupt();
+            until += simTime - start;
+            continue;
+        }
+
+        if (simTime < limit) simTime = limit;
+
+        if (fw && (simTime >= stopTime))
+        {
+            current = NULL;
+            swapcontext(&fwThread.ctx, &harnessCtx);
+            continue;
+        }
+
+        if ((simTime >= until) && (!events || (events->when > until))) break;
+    }
+}
+
+void SimCycles(uint32_t cycles)
+{
+    SimCommit();
+    simCycles += cycles;
+    SimService(simTime + cycles * SimTicksPerCycle());
+}
+
+// - - - - - - - - - - //
+
+static void SimThreadMain()
+{
+    SimThread *t = current;
+
+    t->fn(t->arg);
+    t->done = 1;
+    setcontext(t->caller);
+}
+
+static void SimThreadResume(void *arg)
+{
+    SimThread *t = arg;
+    SimThread *prev = current;
+    ucontext_t here;
+
+    if (t->done) return;
+
+    current = t;
+    t->caller = &here;
+    swapcontext(&here, &t->ctx);
+    current = prev;
+}
+
+SimThread *SimThreadCreate(SimThreadFn fn, void *arg)
+{
+    SimThread *t = calloc(1, sizeof(SimThread));
+
+    t->fn = fn;
+    t->arg = arg;
+    t->stack = malloc(SIM_STACK_SIZE);
+
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->stack;
+    t->ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+    t->ctx.uc_link = NULL;
+    makecontext(&t->ctx, SimThreadMain, 0);
+
+    SimSchedule(simTime, SimThreadResume, t);
+    return t;
+}
+
+void SimWait(SimTime ticks)
+{
+    SimWaitUntil(simTime + ticks);
+}
+
+void SimWaitUntil(SimTime when)
+{
+    SimThread *t = current;
+
+    SimSchedule(when, SimThreadResume, t);
+    swapcontext(&t->ctx, t->caller);
+}
+
+uint8_t SimWaitSignal(SimSignal *sig, SimTime timeout)
+{
+    SimThread *t = current;
+
+    sig->waiter = t;
+    t->signalled = 0;
+    SimSchedule(simTime + timeout, SimThreadResume, t);
+    swapcontext(&t->ctx, t->caller);
+
+    if (sig->waiter == t) sig->waiter = NULL;
+    return t->signalled;
+}
+
+void SimNotify(SimSignal *sig)
+{
+    SimThread *t = sig->waiter;
+
+    if (t)
+    {
+        sig->waiter = NULL;
+        t->signalled = 1;
+        SimCancel(SimThreadResume, t);
+        SimSchedule(simTime, SimThreadResume, t);
+    }
+}
+
+// - - - - - - - - - - //
+
+static void SimFirmwareMain()
+{
+    FirmwareMain();
+
+    fprintf(stderr, "[%10.1f us] firmware returned from main()\n", SIM_US(simTime));
+    halted = 1;
+    while (1) SimCycles(1000);
+}
+
+void SimRunUntil(SimTime when)
+{
+    if (!fwStarted)
+    {
+        fwStarted = 1;
+        fwThread.stack = malloc(SIM_STACK_SIZE);
+        getcontext(&fwThread.ctx);
+        fwThread.ctx.uc_stack.ss_sp = fwThread.stack;
+        fwThread.ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+        fwThread.ctx.uc_link = NULL;
+        makecontext(&fwThread.ctx, SimFirmwareMain, 0);
+    }
+
+    stopTime = when;
+    current = &fwThread;
+    swapcontext(&harnessCtx, &fwThread.ctx);
+}
+
+void SimRunFor(SimTime ticks)
+{
+    SimRunUntil(simTime + ticks);
+}
+
+uint8_t SimHalted()
+{
+    return halted;
+}
@@ -0,0 +1,121 @@
+/*
+ * File:   sim.h
+ * Author: Jackson Snowden
+ */
+
+#ifndef _SIM_H_
+#define	_SIM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "sfr.h"
+
+// Simulation time base is one HFINTOSC period (32 MHz)
+typedef uint64_t SimTime;
+
+#define SIM_HFINTOSC        32000000UL
+#define SIM_TICKS_US(x)     ((SimTime)(x) * (SIM_HFINTOSC / 1000000UL))
+#define SIM_TICKS_MS(x)     ((SimTime)(x) * (SIM_HFINTOSC / 1000UL))
+#define SIM_US(t)           ((double)(t) / (SIM_HFINTOSC / 1000000UL))
+
+// Instruction cycle cost model
+#define SIM_ACCESS_CYCLES   2   // BANKSEL + MOVF/MOVWF/BSF/BTFSC per SFR access
+#define SIM_CALL_CYCLES     6   // CALL + RETURN + argument passing
+#define SIM_IRQ_CYCLES      8   // Interrupt latency + automatic context save/restore
+
+// Port indices
+#define SIM_PORTA   0
+#define SIM_PORTB   1
+#define SIM_PORTC   2
+#define SIM_PORTD   3
+#define SIM_PORTE   4
+
+typedef void (*SimEventFn)(void *arg);
+typedef void (*SimThreadFn)(void *arg);
+typedef void (*SimSyncHook)(uint8_t reg);
+typedef void (*SimWriteHook)(uint8_t reg, uint8_t old);
+
+typedef struct SimThread SimThread;
+
+typedef struct
+{
+    SimThread *waiter;
+}
+SimSignal;
+
+extern volatile uint8_t simSFR[SFR_COUNT];
+extern const char *simSFRname[SFR_COUNT];
+
+extern SimTime simTime;
+extern uint64_t simCycles;
+extern uint64_t simIdleCycles;
+
+// Register access (used by xc.h)
+volatile uint8_t *SimAccess(uint8_t reg);
+
+volatile uint16_t *SimAccessBuf(uint8_t reg);
+
+void SimDelay(uint32_t cycles);
+
+void SimSleep();
+
+void SimJump(uint16_t addr);
+
+// Core
+void SimInit();
+
+void SimCommit();
+
+void SimCycles(uint32_t cycles);
+
+SimTime SimTicksPerCycle();
+
+uint32_t SimFosc();
+
+void SimOnSync(uint8_t reg, SimSyncHook hook);
+
+void SimOnWrite(uint8_t reg, SimWriteHook hook);
+
+void SimOnRead(uint8_t reg, SimSyncHook hook);
+
+void SimSchedule(SimTime when, SimEventFn fn, void *arg);
+
+void SimCancel(SimEventFn fn, void *arg);
+
+// Cooperative threads for bus masters and scripted stimulus
+SimThread *SimThreadCreate(SimThreadFn fn, void *arg);
+
+void SimWait(SimTime ticks);
+
+void SimWaitUntil(SimTime when);
+
+uint8_t SimWaitSignal(SimSignal *sig, SimTime timeout);
+
+void SimNotify(SimSignal *sig);
+
+// Run control
+void SimRunUntil(SimTime when);
+
+void SimRunFor(SimTime ticks);
+
+uint8_t SimHalted();
+
+// Function-level profiler
+typedef struct
+{
+    const char *name;
+    uint32_t calls;
+    uint64_t total;
+    uint32_t min;
+    uint32_t max;
+    uint32_t cost;
+}
+SimProfile;
+
+void SimProfileReset();
+
+SimProfile *SimProfileGet(const char *name);
+
+void SimProfileReport(FILE *out);
+
+#endif  /* _SIM_H_ */
@@ -0,0 +1,184 @@
+/*
+ * File:   simADC.c
+ * Author: Jackson Snowden
+ */
+
+#include "periph.h"
+
+#define ADC_FRC_TAD     SIM_TICKS_US(2)     // Dedicated ADCRC oscillator period
+#define ADC_CONV_TAD    12                  // 10-bit conversion plus sample-and-hold
+
+// ADCON2 ADMD computation modes
+#define ADC_MODE_AVERAGE    0x02
+#define ADC_MODE_BURST      0x03
+
+// 10-bit input level of every analog channel
+uint16_t simAnalog[SIM_ADC_CHANNELS];
+
+// Peak-to-peak noise added to each conversion, in LSBs
+uint8_t simAnalogNoise;
+
+static uint16_t noiseState = 0xACE1;
+
+static uint16_t ADCsample(uint8_t channel)
+{
+    int32_t value = simAnalog[channel % SIM_ADC_CHANNELS];
+
+    if (simAnalogNoise)
+    {
+        // Deterministic 16-bit Galois LFSR
+        noiseState = (noiseState >> 1) ^ (-(noiseState & 1) & 0xB400);
+        value += (int32_t)(noiseState % (simAnalogNoise + 1)) - (simAnalogNoise / 2);
+    }
+
+    if (value < 0) value = 0;
+    if (value > 1023) value = 1023;
+    return value;
+}
+
+static SimTime ADCtad()
+{
+    if (simSFR[SFR_ADCON0] & 0x10) return ADC_FRC_TAD;
+
+    // FOSC / (2 * (ADCS + 1))
+    return (SimTime)(2 * ((simSFR[SFR_ADCLK] & 0x3F) + 1)) * (SimTicksPerCycle() / 4);
+}
+
+static void ADCstart();
+
+static void ADCcompute(uint16_t result)
+{
+    uint32_t acc = ((uint32_t)simSFR[SFR_ADACCU] << 16) | (simSFR[SFR_ADACCH] << 8) | simSFR[SFR_ADACCL];
+    uint16_t filter;
+    uint8_t count = simSFR[SFR_ADCNT];
+
+    acc = (acc + result) & 0x3FFFF;
+    if (count < 0xFF) count++;
+
+    simSFR[SFR_ADACCU] = acc >> 16;
+    simSFR[SFR_ADACCH] = acc >> 8;
+    simSFR[SFR_ADACCL] = acc & 0xFF;
+    simSFR[SFR_ADCNT] = count;
+
+    if (count < simSFR[SFR_ADRPT]) return;
+
+    // Average and Burst Average: ADFLTR = ADACC >> ADCRS once ADRPT samples are in
+    filter = acc >> ((simSFR[SFR_ADCON2] >> 4) & 0x07);
+    simSFR[SFR_ADFLTRH] = filter >> 8;
+    simSFR[SFR_ADFLTRL] = filter & 0xFF;
+
+    // Only ADTMD = 111 (always) is modelled for the threshold test
+    if ((simSFR[SFR_ADCON3] & 0x07) == 0x07) simSFR[SFR_PIR1] |= 0x02;     // ADTIF
+}
+
+static void ADCcomplete(void *arg)
+{
+    uint16_t result = ADCsample(simSFR[SFR_ADPCH] & 0x3F);
+    uint8_t mode = simSFR[SFR_ADCON2] & 0x07;
+
+    if (simSFR[SFR_ADCON0] & 0x04)
+    {
+        simSFR[SFR_ADRESH] = result >> 8;
+        simSFR[SFR_ADRESL] = result & 0xFF;
+    }
+    else
+    {
+        simSFR[SFR_ADRESH] = result >> 2;
+        simSFR[SFR_ADRESL] = (result & 0x03) << 6;
+    }
+
+    simSFR[SFR_PIR1] |= 0x01;       // ADIF
+
+    if ((mode == ADC_MODE_AVERAGE) || (mode == ADC_MODE_BURST))
+    {
+        ADCcompute(result);
+
+        // A burst keeps converting the same channel until ADRPT samples are in
+        if ((mode == ADC_MODE_BURST) && (simSFR[SFR_ADCNT] < simSFR[SFR_ADRPT]))
+        {
+            ADCstart();
+            return;
+        }
+    }
+
+    simSFR[SFR_ADCON0] &= ~0x01;    // ADGO
+}
+
+static void ADCclear()
+{
+    simSFR[SFR_ADACCU] = 0;
+    simSFR[SFR_ADACCH] = 0;
+    simSFR[SFR_ADACCL] = 0;
+    simSFR[SFR_ADCNT] = 0;
+}
+
+static void ADCstart()
+{
+    SimTime tad = ADCtad();
+    SimTime duration = (simSFR[SFR_ADPRE] + simSFR[SFR_ADACQ] + ADC_CONV_TAD) * tad;
+
+    SimSchedule(simTime + duration, ADCcomplete, NULL);
+}
+
+static void ADCbegin()
+{
+    uint8_t mode = simSFR[SFR_ADCON2] & 0x07;
+
+    // Burst Average starts from an empty accumulator on every trigger,
+    // Average clears it at the first conversion after a completed set
+    if ((mode == ADC_MODE_BURST) || ((mode == ADC_MODE_AVERAGE) && (simSFR[SFR_ADCNT] >= simSFR[SFR_ADRPT]))) ADCclear();
+
+    ADCstart();
+}
+
+static void ADCwrite(uint8_t reg, uint8_t old)
+{
+    uint8_t con = simSFR[SFR_ADCON0];
+
+    if (!(con & 0x80) || !(con & 0x01))
+    {
+        // Module off or conversion aborted
+        SimCancel(ADCcomplete, NULL);
+        return;
+    }
+
+    if (!(old & 0x01)) ADCbegin();
+}
+
+static void ADCcon2Write(uint8_t reg, uint8_t old)
+{
+    // ADACLR clears the accumulator and count, then reads back as zero
+    if (simSFR[reg] & 0x08)
+    {
+        ADCclear();
+        simSFR[reg] &= ~0x08;
+    }
+}
+
+void SimADCinit()
+{
+    uint8_t i;
+
+    // Sticks centered, triggers released
+    for (i = 0; i < SIM_ADC_CHANNELS; i++) simAnalog[i] = 512;
+
+    SimOnWrite(SFR_ADCON0, ADCwrite);
+    SimOnWrite(SFR_ADCON2, ADCcon2Write);
+}
+
+void SimAnalogSet(uint8_t channel, uint16_t value)
+{
+    simAnalog[channel % SIM_ADC_CHANNELS] = value & 0x3FF;
+}
+
+void SimADCtrigger(uint8_t source)
+{
+    uint8_t con = simSFR[SFR_ADCON0];
+
+    // Auto-conversion trigger sets ADGO unless a conversion is running
+    if ((simSFR[SFR_ADACT] & 0x1F) != source) return;
+    if (!(con & 0x80) || (con & 0x01)) return;
+
+    simSFR[SFR_ADCON0] = con | 0x01;
+    ADCbegin();
+}
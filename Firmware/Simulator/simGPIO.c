@@ -0,0 +1,121 @@
+/*
+ * File:   simGPIO.c
+ * Author: Jackson Snowden
+ */
+
+#include "periph.h"
+
+#define PIN_HOOKS   8
+
+// IOC register block for each port, PORTD has no interrupt-on-change
+static const int16_t iocBase[5] = { SFR_IOCAP, SFR_IOCBP, SFR_IOCCP, -1, SFR_IOCEP };
+static const uint8_t iocPins[5] = { 0xFF, 0xFF, 0xFF, 0x00, 0x08 };
+
+// Externally driven pin levels, idle high through the button pull-ups
+uint8_t simPinIn[5];
+
+static SimPinHook pinHooks[PIN_HOOKS];
+static uint8_t pinHookCount;
+
+static void GPIOsync(uint8_t reg)
+{
+    uint8_t p = reg - SFR_PORTA;
+    uint8_t tris = simSFR[SFR_TRISA + p];
+    uint8_t digital = ~simSFR[SFR_ANSELA + p];
+
+    simSFR[reg] = (simPinIn[p] & tris & digital) | (simSFR[SFR_LATA + p] & ~tris);
+}
+
+static void GPIOoutput(uint8_t p, uint8_t old)
+{
+    uint8_t changed = (old ^ simSFR[SFR_LATA + p]) & ~simSFR[SFR_TRISA + p];
+    uint8_t b;
+    uint8_t i;
+
+    for (b = 0; b < 8; b++)
+    {
+        if (!(changed & (1 << b))) continue;
+        for (i = 0; i < pinHookCount; i++) pinHooks[i](p, b, (simSFR[SFR_LATA + p] >> b) & 1);
+    }
+}
+
+static void GPIOlatWrite(uint8_t reg, uint8_t old)
+{
+    GPIOoutput(reg - SFR_LATA, old);
+}
+
+static void GPIOportWrite(uint8_t reg, uint8_t old)
+{
+    // Writes to PORTx go to the output latch
+    uint8_t p = reg - SFR_PORTA;
+    uint8_t latOld = simSFR[SFR_LATA + p];
+
+    simSFR[SFR_LATA + p] = simSFR[reg];
+    GPIOoutput(p, latOld);
+}
+
+static void IOCupdateFlag()
+{
+    // IOCIF is the OR of every IOCxF bit
+    if (simSFR[SFR_IOCAF] | simSFR[SFR_IOCBF] | simSFR[SFR_IOCCF] | simSFR[SFR_IOCEF]) simSFR[SFR_PIR0] |= 0x10;
+    else simSFR[SFR_PIR0] &= ~0x10;
+}
+
+static void IOCflagWrite(uint8_t reg, uint8_t old)
+{
+    IOCupdateFlag();
+}
+
+static void IOCedge(uint8_t p, uint8_t old)
+{
+    int16_t base = iocBase[p];
+    uint8_t digital = simSFR[SFR_TRISA + p] & ~simSFR[SFR_ANSELA + p] & iocPins[p];
+    uint8_t rising = ~old & simPinIn[p] & digital;
+    uint8_t falling = old & ~simPinIn[p] & digital;
+    uint8_t flags;
+
+    if (base < 0) return;
+
+    flags = (rising & simSFR[base]) | (falling & simSFR[base + 1]);
+    if (!flags) return;
+
+    simSFR[base + 2] |= flags;
+    IOCupdateFlag();
+}
+
+void SimGPIOinit()
+{
+    uint8_t p;
+
+    for (p = 0; p < 5; p++)
+    {
+        simPinIn[p] = 0xFF;
+        SimOnSync(SFR_PORTA + p, GPIOsync);
+        SimOnWrite(SFR_PORTA + p, GPIOportWrite);
+        SimOnWrite(SFR_LATA + p, GPIOlatWrite);
+        if (iocBase[p] >= 0) SimOnWrite(iocBase[p] + 2, IOCflagWrite);
+    }
+}
+
+void SimPinSet(SimPin pin, uint8_t level)
+{
+    uint8_t old = simPinIn[pin.port];
+
+    if (level) simPinIn[pin.port] |= (1 << pin.bit);
+    else simPinIn[pin.port] &= ~(1 << pin.bit);
+
+    IOCedge(pin.port, old);
+}
+
+uint8_t SimPinGet(SimPin pin)
+{
+    uint8_t tris = simSFR[SFR_TRISA + pin.port];
+    uint8_t level = (simPinIn[pin.port] & tris) | (simSFR[SFR_LATA + pin.port] & ~tris);
+
+    return (level >> pin.bit) & 1;
+}
+
+void SimOnPinOutput(SimPinHook hook)
+{
+    if (pinHookCount < PIN_HOOKS) pinHooks[pinHookCount++] = hook;
+}
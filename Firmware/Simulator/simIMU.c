@@ -0,0 +1,250 @@
+/*
+ * File:   simIMU.c
+ * Author: Jackson Snowden
+ *
+ * LSM6DS3 register model on the MSSP2 SPI bus. Output registers are
+ * refreshed lazily from simulation time at the configured data rate.
+ * The FIFO holds accelerometer words in continuous mode only, at the
+ * accelerometer data rate. The LPF2 filter is not modelled.
+ */
+
+#include "pins.h"
+#include "config.h"
+#include "IMU.h"
+
+#define IMU_BOOT_TIME   SIM_TICKS_MS(15)    // Turn-on time before registers respond
+#define IMU_REG_COUNT   0x80
+
+#define XLDA            0x01
+#define FIFO_WORDS      2048    // 8 kbyte FIFO
+#define FIFO_EMPTY      0x10
+#define FIFO_OVER_RUN   0x40
+#define FIFO_WATERM     0x80
+
+// Peak-to-peak accelerometer noise in mg
+uint8_t simIMUnoise;
+
+SimTime simIMUfirstData;
+
+static uint8_t reg[IMU_REG_COUNT];
+static int16_t accelMg[3];
+
+static uint8_t selected;
+static uint8_t first;
+static uint8_t addr;
+static uint8_t readCmd;
+
+static SimTime odrStart;
+static uint64_t sampleIndex;
+static uint16_t noiseState = 0x1D87;
+
+static int16_t fifo[FIFO_WORDS];
+static uint16_t fifoHead;
+static uint16_t fifoCount;
+static uint32_t fifoPattern;
+static uint8_t fifoOverrun;
+
+static void FIFOclear()
+{
+    fifoHead = 0;
+    fifoCount = 0;
+    fifoPattern = 0;
+    fifoOverrun = 0;
+}
+
+static uint8_t FIFOenabled()
+{
+    return ((reg[FIFO_CTRL5] & 0x07) == 0x06) && (reg[FIFO_CTRL3] & 0x07);
+}
+
+static void FIFOpush(int16_t word)
+{
+    // Continuous mode overwrites the oldest word
+    if (fifoCount == FIFO_WORDS)
+    {
+        fifoHead = (fifoHead + 1) % FIFO_WORDS;
+        fifoPattern++;
+        fifoCount--;
+        fifoOverrun = 1;
+    }
+
+    fifo[(fifoHead + fifoCount) % FIFO_WORDS] = word;
+    fifoCount++;
+}
+
+static void FIFOstatus()
+{
+    uint16_t threshold = ((reg[FIFO_CTRL2] & 0x0F) << 8) | reg[FIFO_CTRL1];
+
+    reg[FIFO_STATUS1] = fifoCount & 0xFF;
+    reg[FIFO_STATUS2] = ((fifoCount >> 8) & 0x0F) | (fifoCount ? 0 : FIFO_EMPTY) | (fifoOverrun ? FIFO_OVER_RUN : 0) |
+                        ((fifoCount >= threshold) ? FIFO_WATERM : 0);
+    reg[FIFO_STATUS3] = fifoPattern % 3;
+    reg[FIFO_STATUS4] = 0;
+}
+
+static uint8_t FIFOread(uint8_t a)
+{
+    int16_t word = fifoCount ? fifo[fifoHead] : 0;
+
+    if (a == FIFO_DATA_OUT_L) return word & 0xFF;
+
+    // Word is consumed with its high byte
+    if (fifoCount)
+    {
+        fifoHead = (fifoHead + 1) % FIFO_WORDS;
+        fifoCount--;
+        fifoPattern++;
+    }
+    return (word >> 8) & 0xFF;
+}
+
+static void IMUreset()
+{
+    uint8_t i;
+
+    for (i = 0; i < IMU_REG_COUNT; i++) reg[i] = 0;
+    reg[ID_REG] = IMU_ID;
+    reg[CTRL3_C] = 0x04;    // IF_INC
+    sampleIndex = 0;
+    FIFOclear();
+}
+
+static SimTime IMUodrPeriod()
+{
+    uint8_t odr = reg[CTRL1_XL] >> 4;
+
+    if (!odr || (odr > 10)) return 0;
+
+    // 12.5 Hz * 2^(ODR - 1)
+    return (SimTime)(SIM_HFINTOSC * 2 / 25) >> (odr - 1);
+}
+
+static int16_t IMUnoise()
+{
+    if (!simIMUnoise) return 0;
+    noiseState = (noiseState >> 1) ^ (-(noiseState & 1) & 0xB400);
+    return (int16_t)(noiseState % (simIMUnoise + 1)) - (simIMUnoise / 2);
+}
+
+static void IMUsample()
+{
+    // FS_XL = CTRL1_XL[3:2], sensitivity in ug/LSB
+    static const uint16_t sensitivity[4] = { 61, 488, 122, 244 };
+    SimTime period = IMUodrPeriod();
+    uint64_t index;
+    uint64_t count;
+    uint8_t i;
+
+    if (!period) return;
+
+    index = (simTime - odrStart) / period;
+    if (index == sampleIndex) return;
+
+    // Every elapsed sample goes through the FIFO, the output registers keep the last
+    count = index - sampleIndex;
+    if (!FIFOenabled()) count = 1;
+    else if (count > FIFO_WORDS / 3 + 1) count = FIFO_WORDS / 3 + 1;
+    sampleIndex = index;
+
+    while (count--)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            int32_t raw = ((int32_t)(accelMg[i] + IMUnoise()) * 1000) / sensitivity[(reg[CTRL1_XL] >> 2) & 0x03];
+            if (raw > 32767) raw = 32767;
+            if (raw < -32768) raw = -32768;
+            reg[OUTX_L_XL + 2 * i] = raw & 0xFF;
+            reg[OUTX_H_XL + 2 * i] = (raw >> 8) & 0xFF;
+            if (FIFOenabled()) FIFOpush((int16_t)raw);
+        }
+    }
+
+    reg[STATUS_REG] |= XLDA;
+}
+
+static uint8_t IMUread(uint8_t a)
+{
+    IMUsample();
+
+    if (((a >= OUTX_L_XL) && (a <= OUTZ_H_XL)) || (a == FIFO_DATA_OUT_L) || (a == FIFO_DATA_OUT_H))
+    {
+        if (!simIMUfirstData) simIMUfirstData = simTime;
+    }
+
+    if ((a >= OUTX_L_XL) && (a <= OUTZ_H_XL)) reg[STATUS_REG] &= ~XLDA;
+    if ((a == FIFO_DATA_OUT_L) || (a == FIFO_DATA_OUT_H)) return FIFOread(a);
+    if ((a >= FIFO_STATUS1) && (a <= FIFO_STATUS4)) FIFOstatus();
+    return reg[a];
+}
+
+static void IMUwrite(uint8_t a, uint8_t data)
+{
+    // Read-only registers
+    if ((a == ID_REG) || (a == STATUS_REG) || ((a >= 0x20) && (a <= 0x3F))) return;
+
+    if ((a == CTRL3_C) && (data & 0x01))
+    {
+        IMUreset();
+        return;
+    }
+
+    // Bypass mode empties the FIFO
+    if ((a == FIFO_CTRL5) && ((data & 0x07) == 0x00)) FIFOclear();
+
+    if ((a == CTRL1_XL) && ((data ^ reg[a]) & 0xF0))
+    {
+        odrStart = simTime;
+        sampleIndex = 0;
+    }
+
+    reg[a] = data;
+}
+
+static void IMUselect(uint8_t active)
+{
+    selected = active && (simTime >= IMU_BOOT_TIME);
+    first = 1;
+}
+
+static uint8_t IMUtransfer(uint8_t mosi)
+{
+    uint8_t miso = 0xFF;
+
+    if (!selected) return 0x00;
+
+    if (first)
+    {
+        first = 0;
+        readCmd = mosi & 0x80;
+        addr = mosi & 0x7F;
+        return miso;
+    }
+
+    if (readCmd) miso = IMUread(addr);
+    else IMUwrite(addr, mosi);
+
+    // FIFO output rolls back to FIFO_DATA_OUT_L
+    if (addr == FIFO_DATA_OUT_H) addr = FIFO_DATA_OUT_L;
+    else if (reg[CTRL3_C] & 0x04) addr = (addr + 1) & 0x7F;
+    return miso;
+}
+
+static const SimSPIdevice imuDevice = { IMUselect, IMUtransfer };
+
+void SimIMUinit()
+{
+    IMUreset();
+    simIMUfirstData = 0;
+    accelMg[0] = 0;
+    accelMg[1] = 0;
+    accelMg[2] = 1000;
+    SimSPIattach(&imuDevice, CS);
+}
+
+void SimIMUsetAccel(int16_t x, int16_t y, int16_t z)
+{
+    accelMg[0] = x;
+    accelMg[1] = y;
+    accelMg[2] = z;
+}
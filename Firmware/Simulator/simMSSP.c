@@ -0,0 +1,276 @@
+/*
+ * File:   simMSSP.c
+ * Author: Jackson Snowden
+ */
+
+#include "periph.h"
+
+// SSPxSTAT bits
+#define STAT_BF     0x01
+#define STAT_RW     0x04
+#define STAT_S      0x08
+#define STAT_P      0x10
+#define STAT_DA     0x20
+
+// SSPxCON1 bits
+#define CON1_SSPOV  0x40
+#define CON1_SSPEN  0x20
+#define CON1_CKP    0x10
+
+// SSPxCON2/3 bits
+#define CON2_SEN    0x01
+#define CON2_ACKSTAT 0x40
+#define CON3_PCIE   0x40
+
+// PIR3 bits
+#define PIR_SSP1IF  0x01
+#define PIR_SSP2IF  0x04
+
+#define I2C_STRETCH_TIMEOUT SIM_TICKS_MS(10)
+
+SimI2Cstats simI2Cstats;
+
+static SimTime bitTime = SIM_HFINTOSC / 400000;
+static SimSignal release;
+static uint8_t addressed;
+static uint8_t reading;
+
+static const SimSPIdevice *spiDevice;
+static SimPin spiCS;
+static uint8_t spiBusy;
+static uint8_t spiTx;
+
+// - - - - - - - - - - //
+
+static uint8_t I2Cenabled()
+{
+    return simSFR[SFR_SSP1CON1] & CON1_SSPEN;
+}
+
+static void I2Cinterrupt()
+{
+    simSFR[SFR_PIR3] |= PIR_SSP1IF;
+}
+
+static void I2Cstretch(uint8_t state)
+{
+    // Slave holds SCL low after the 9th clock until firmware sets CKP
+    SimTime start = simTime;
+
+    if (simSFR[SFR_SSP1CON1] & CON1_CKP) return;
+
+    if (!SimWaitSignal(&release, I2C_STRETCH_TIMEOUT))
+    {
+        simI2Cstats.timeouts++;
+        simSFR[SFR_SSP1CON1] |= CON1_CKP;
+    }
+
+    simI2Cstats.stretches++;
+    simI2Cstats.stretchTotal += simTime - start;
+    if (simTime - start > simI2Cstats.stretchMax) simI2Cstats.stretchMax = simTime - start;
+    if (simTime - start > simI2Cstats.stateMax[state]) simI2Cstats.stateMax[state] = simTime - start;
+}
+
+static void I2Ccon1Write(uint8_t reg, uint8_t old)
+{
+    if ((simSFR[reg] & CON1_CKP) && !(old & CON1_CKP)) SimNotify(&release);
+    if (!(simSFR[reg] & CON1_SSPEN)) addressed = 0;
+}
+
+static void I2CbufRead(uint8_t reg)
+{
+    simSFR[SFR_SSP1STAT] &= ~STAT_BF;
+}
+
+void SimI2CsetClock(uint32_t hz)
+{
+    bitTime = SIM_HFINTOSC / hz;
+}
+
+void SimI2Cstart()
+{
+    SimWait(bitTime);
+
+    addressed = 0;
+    reading = 0;
+    if (!I2Cenabled()) return;
+
+    simSFR[SFR_SSP1STAT] = (simSFR[SFR_SSP1STAT] & ~STAT_P) | STAT_S;
+}
+
+static uint8_t I2Creceive(uint8_t data, uint8_t isAddress)
+{
+    uint8_t stat = simSFR[SFR_SSP1STAT];
+
+    // Receiving while the last byte is unread overflows and NACKs
+    if (stat & STAT_BF)
+    {
+        simSFR[SFR_SSP1CON1] |= CON1_SSPOV;
+        I2Cinterrupt();
+        return 0;
+    }
+
+    simSFR[SFR_SSP1BUF] = data;
+    stat |= STAT_BF;
+    if (isAddress) stat &= ~STAT_DA;
+    else stat |= STAT_DA;
+    if (reading) stat |= STAT_RW;
+    else stat &= ~STAT_RW;
+    simSFR[SFR_SSP1STAT] = stat;
+
+    if (reading || (simSFR[SFR_SSP1CON2] & CON2_SEN)) simSFR[SFR_SSP1CON1] &= ~CON1_CKP;
+    I2Cinterrupt();
+    return 1;
+}
+
+uint8_t SimI2Cwrite(uint8_t data)
+{
+    uint8_t ack = 0;
+    uint8_t state = SIM_I2C_WRITE_DATA;
+
+    SimWait(9 * bitTime);
+
+    if (I2Cenabled())
+    {
+        if (!addressed)
+        {
+            uint8_t mask = simSFR[SFR_SSP1MSK] & 0xFE;
+
+            if (!((data ^ simSFR[SFR_SSP1ADD]) & mask))
+            {
+                addressed = 1;
+                reading = data & 0x01;
+                simSFR[SFR_SSP1CON2] &= ~CON2_ACKSTAT;
+                state = reading ? SIM_I2C_READ_ADDR : SIM_I2C_WRITE_ADDR;
+                ack = I2Creceive(data, 1);
+            }
+        }
+        else if (!reading) ack = I2Creceive(data, 0);
+    }
+
+    if (ack) simI2Cstats.bytes++;
+    if (ack && I2Cenabled()) I2Cstretch(state);
+
+    return ack;
+}
+
+uint8_t SimI2Cread(uint8_t ack)
+{
+    uint8_t data = 0xFF;
+
+    if (addressed && reading && I2Cenabled())
+    {
+        data = simSFR[SFR_SSP1BUF];
+        simSFR[SFR_SSP1STAT] &= ~STAT_BF;
+    }
+
+    SimWait(9 * bitTime);
+
+    if (addressed && reading && I2Cenabled())
+    {
+        simI2Cstats.bytes++;
+
+        // Master ACK/NACK is reported through ACKSTAT on the 9th clock
+        if (ack) simSFR[SFR_SSP1CON2] &= ~CON2_ACKSTAT;
+        else simSFR[SFR_SSP1CON2] |= CON2_ACKSTAT;
+        simSFR[SFR_SSP1STAT] |= STAT_DA | STAT_RW;
+
+        if (ack) simSFR[SFR_SSP1CON1] &= ~CON1_CKP;
+        I2Cinterrupt();
+        if (ack) I2Cstretch(SIM_I2C_READ_DATA);
+        else addressed = 0;
+    }
+
+    return data;
+}
+
+void SimI2Cstop()
+{
+    SimWait(bitTime);
+
+    addressed = 0;
+    if (!I2Cenabled()) return;
+
+    simSFR[SFR_SSP1STAT] = (simSFR[SFR_SSP1STAT] & ~(STAT_S | STAT_RW)) | STAT_P;
+    if (simSFR[SFR_SSP1CON3] & CON3_PCIE) I2Cinterrupt();
+}
+
+// - - - - - - - - - - //
+
+static void SPIcomplete(void *arg)
+{
+    uint8_t rx = 0xFF;
+
+    if (spiDevice && !SimPinGet(spiCS)) rx = spiDevice->transfer(spiTx);
+
+    spiBusy = 0;
+    simSFR[SFR_SSP2BUF] = rx;
+    simSFR[SFR_SSP2STAT] |= STAT_BF;
+    simSFR[SFR_PIR3] |= PIR_SSP2IF;
+}
+
+static void SPIbufWrite(uint8_t reg, uint8_t old)
+{
+    uint8_t con1 = simSFR[SFR_SSP2CON1];
+    SimTime clocks;
+
+    if (!(con1 & CON1_SSPEN)) return;
+
+    if (spiBusy)
+    {
+        simSFR[SFR_SSP2CON1] |= 0x80;   // WCOL
+        return;
+    }
+
+    // SPI master clock select
+    switch (con1 & 0x0F)
+    {
+        case 0x0: clocks = 4; break;
+        case 0x1: clocks = 16; break;
+        case 0x2: clocks = 64; break;
+        case 0xA: clocks = 4 * ((SimTime)simSFR[SFR_SSP2ADD] + 1); break;
+        default: return;
+    }
+
+    spiBusy = 1;
+    spiTx = simSFR[reg];
+    simSFR[SFR_SSP2STAT] &= ~STAT_BF;
+    SimSchedule(simTime + 8 * clocks * (SimTicksPerCycle() / 4), SPIcomplete, NULL);
+}
+
+static void SPIbufRead(uint8_t reg)
+{
+    simSFR[SFR_SSP2STAT] &= ~STAT_BF;
+}
+
+static void SPIcon1Write(uint8_t reg, uint8_t old)
+{
+    if (!(simSFR[reg] & CON1_SSPEN))
+    {
+        SimCancel(SPIcomplete, NULL);
+        spiBusy = 0;
+    }
+}
+
+static void SPIpin(uint8_t port, uint8_t bit, uint8_t level)
+{
+    if (spiDevice && (port == spiCS.port) && (bit == spiCS.bit)) spiDevice->select(!level);
+}
+
+void SimSPIattach(const SimSPIdevice *dev, SimPin cs)
+{
+    spiDevice = dev;
+    spiCS = cs;
+}
+
+// - - - - - - - - - - //
+
+void SimMSSPinit()
+{
+    SimOnWrite(SFR_SSP1CON1, I2Ccon1Write);
+    SimOnRead(SFR_SSP1BUF, I2CbufRead);
+    SimOnWrite(SFR_SSP2BUF, SPIbufWrite);
+    SimOnRead(SFR_SSP2BUF, SPIbufRead);
+    SimOnWrite(SFR_SSP2CON1, SPIcon1Write);
+    SimOnPinOutput(SPIpin);
+}
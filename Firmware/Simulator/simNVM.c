@@ -0,0 +1,73 @@
+/*
+ * File:   simNVM.c
+ * Author: Jackson Snowden
+ */
+
+#include "periph.h"
+
+#define EE_WRITE_TIME   SIM_TICKS_MS(4)     // Data EEPROM byte write (TDEW)
+#define EE_ADDR_HIGH    0xF0                // DFM is mapped at 0xF000 with NVMREGS = 1
+
+uint8_t simEE[SIM_EE_SIZE];
+
+static uint8_t unlockState;
+static uint8_t writeAddr;
+static uint8_t writeData;
+
+static void NVMwriteDone(void *arg)
+{
+    simEE[writeAddr] = writeData;
+    simSFR[SFR_NVMCON1] &= ~0x02;   // WR
+}
+
+static void NVMcon2Write(uint8_t reg, uint8_t old)
+{
+    // Unlock sequence is 0x55 followed by 0xAA, register reads back as 0
+    if (simSFR[reg] == 0x55) unlockState = 1;
+    else if ((simSFR[reg] == 0xAA) && (unlockState == 1)) unlockState = 2;
+    else unlockState = 0;
+
+    simSFR[reg] = 0;
+}
+
+static void NVMcon1Write(uint8_t reg, uint8_t old)
+{
+    uint8_t con = simSFR[reg];
+    uint8_t dfm = (con & 0x40) && (simSFR[SFR_NVMADRH] == EE_ADDR_HIGH);
+
+    if ((con & 0x01) && !(old & 0x01))
+    {
+        // RD completes immediately
+        if (dfm) simSFR[SFR_NVMDATL] = simEE[simSFR[SFR_NVMADRL]];
+        else simSFR[SFR_NVMDATL] = 0xFF;
+        simSFR[SFR_NVMDATH] = 0;
+        simSFR[reg] &= ~0x01;
+    }
+
+    if ((con & 0x02) && !(old & 0x02))
+    {
+        if (dfm && (con & 0x04) && (unlockState == 2))
+        {
+            writeAddr = simSFR[SFR_NVMADRL];
+            writeData = simSFR[SFR_NVMDATL];
+            SimSchedule(simTime + EE_WRITE_TIME, NVMwriteDone, NULL);
+        }
+        else
+        {
+            simSFR[reg] &= ~0x02;
+            simSFR[reg] |= 0x08;    // WRERR
+        }
+
+        unlockState = 0;
+    }
+}
+
+void SimNVMinit()
+{
+    uint16_t i;
+
+    for (i = 0; i < SIM_EE_SIZE; i++) simEE[i] = 0xFF;
+
+    SimOnWrite(SFR_NVMCON1, NVMcon1Write);
+    SimOnWrite(SFR_NVMCON2, NVMcon2Write);
+}
@@ -0,0 +1,255 @@
+/*
+ * File:   simTMR.c
+ * Author: Jackson Snowden
+ *
+ * TMR2 and TMR4 in free-running period mode. The counter is derived from
+ * simulation time when read, period matches are scheduled as events.
+ *
+ * TMR1 and TMR3 as free-running 16-bit counters for timestamps, without
+ * the gate or overflow interrupt.
+ */
+
+#include "periph.h"
+
+// Register offsets from TxTMR, same layout for every instance
+#define TMR_PR      1
+#define TMR_CON     2
+#define TMR_CLKCON  4
+
+typedef struct
+{
+    uint8_t base;           // SFR index of TxTMR
+    uint8_t flag;           // PIR4 interrupt flag
+    uint8_t trigger;        // ADACT source code
+    SimTime start;          // Time at which the counter was last zero
+    SimTime tick;           // Ticks per counter increment
+    uint8_t post;
+}
+SimTimer;
+
+static SimTimer timers[] =
+{
+    { SFR_T2TMR, 0x02, SIM_ADACT_TMR2 },
+    { SFR_T4TMR, 0x08, SIM_ADACT_TMR4 },
+};
+
+#define TIMER_COUNT (sizeof(timers) / sizeof(timers[0]))
+
+static SimTimer *TxFind(uint8_t reg)
+{
+    uint8_t i;
+
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        if ((reg >= timers[i].base) && (reg <= timers[i].base + TMR_CLKCON)) return &timers[i];
+    }
+
+    return NULL;
+}
+
+static SimTime TxTick(SimTimer *t)
+{
+    SimTime tick;
+
+    switch (simSFR[t->base + TMR_CLKCON] & 0x0F)
+    {
+        case 0x1: tick = SimTicksPerCycle(); break;         // FOSC/4
+        case 0x2: tick = SimTicksPerCycle() / 4; break;     // FOSC
+        case 0x3: tick = 1; break;                          // HFINTOSC
+        case 0x5: tick = SIM_HFINTOSC / 500000; break;      // MFINTOSC 500 kHz
+        default: return 0;
+    }
+
+    // CKPS prescaler 1:1 to 1:128
+    return tick << ((simSFR[t->base + TMR_CON] >> 4) & 0x07);
+}
+
+static uint8_t TxCount(SimTimer *t)
+{
+    if (!t->tick) return simSFR[t->base];
+    return (simTime - t->start) / t->tick;
+}
+
+static void TxMatch(void *arg);
+
+static void TxSchedule(SimTimer *t, uint8_t count)
+{
+    uint8_t pr = simSFR[t->base + TMR_PR];
+
+    SimCancel(TxMatch, t);
+    t->tick = 0;
+
+    if (!(simSFR[t->base + TMR_CON] & 0x80)) return;
+
+    t->tick = TxTick(t);
+    if (!t->tick) return;
+
+    // Counter matches TxPR and resets on the following increment
+    if (count > pr) count = 0;
+    t->start = simTime - count * t->tick;
+    SimSchedule(t->start + ((SimTime)pr + 1) * t->tick, TxMatch, t);
+}
+
+static void TxMatch(void *arg)
+{
+    SimTimer *t = arg;
+
+    simSFR[t->base] = 0;
+
+    if (++t->post > (simSFR[t->base + TMR_CON] & 0x0F))
+    {
+        t->post = 0;
+        simSFR[SFR_PIR4] |= t->flag;
+        SimADCtrigger(t->trigger);
+    }
+
+    // Picks up clock changes once per period
+    TxSchedule(t, 0);
+}
+
+static void TxSync(uint8_t reg)
+{
+    simSFR[reg] = TxCount(TxFind(reg));
+}
+
+static void TxCounterWrite(uint8_t reg, uint8_t old)
+{
+    SimTimer *t = TxFind(reg);
+
+    t->post = 0;
+    TxSchedule(t, simSFR[reg]);
+}
+
+static void TxConfigWrite(uint8_t reg, uint8_t old)
+{
+    SimTimer *t = TxFind(reg);
+    uint8_t count = TxCount(t);
+
+    // Prescaler and postscaler are cleared by writes to TxCON
+    if (reg == t->base + TMR_CON) t->post = 0;
+    simSFR[t->base] = count;
+    TxSchedule(t, count);
+}
+
+// - - - - - - - - - - //
+
+typedef struct
+{
+    uint8_t con;            // SFR indexes of this instance
+    uint8_t clk;
+    uint8_t low;
+    uint8_t high;
+    SimTime start;          // Time at which the counter was last zero
+    SimTime tick;           // Ticks per counter increment
+}
+SimTimer16;
+
+static SimTimer16 timers16[] =
+{
+    { SFR_T1CON, SFR_T1CLK, SFR_TMR1L, SFR_TMR1H },
+    { SFR_T3CON, SFR_T3CLK, SFR_TMR3L, SFR_TMR3H },
+};
+
+#define TIMER16_COUNT (sizeof(timers16) / sizeof(timers16[0]))
+
+static SimTimer16 *T16find(uint8_t reg)
+{
+    uint8_t i;
+
+    for (i = 0; i < TIMER16_COUNT; i++)
+    {
+        SimTimer16 *t = &timers16[i];
+        if ((reg == t->con) || (reg == t->clk) || (reg == t->low) || (reg == t->high)) return t;
+    }
+
+    return NULL;
+}
+
+static SimTime T16tick(SimTimer16 *t)
+{
+    SimTime tick;
+
+    if (!(simSFR[t->con] & 0x01)) return 0;
+
+    switch (simSFR[t->clk] & 0x0F)
+    {
+        case 0x1: tick = SimTicksPerCycle(); break;         // FOSC/4
+        case 0x2: tick = SimTicksPerCycle() / 4; break;     // FOSC
+        case 0x3: tick = 1; break;                          // HFINTOSC
+        case 0x5: tick = SIM_HFINTOSC / 500000; break;      // MFINTOSC 500 kHz
+        default: return 0;
+    }
+
+    // CKPS prescaler 1:1 to 1:8
+    return tick << ((simSFR[t->con] >> 4) & 0x03);
+}
+
+static uint16_t T16count(SimTimer16 *t)
+{
+    if (!t->tick) return (simSFR[t->high] << 8) | simSFR[t->low];
+    return (simTime - t->start) / t->tick;
+}
+
+static void T16rebase(SimTimer16 *t, uint16_t count)
+{
+    t->tick = T16tick(t);
+    t->start = simTime - count * t->tick;
+}
+
+static void T16sync(uint8_t reg)
+{
+    SimTimer16 *t = T16find(reg);
+    uint16_t count = T16count(t);
+
+    // With RD16 the high byte is latched by the low byte read
+    if ((reg == t->high) && (simSFR[t->con] & 0x02)) return;
+
+    simSFR[t->low] = count & 0xFF;
+    simSFR[t->high] = count >> 8;
+}
+
+static void T16counterWrite(uint8_t reg, uint8_t old)
+{
+    SimTimer16 *t = T16find(reg);
+
+    T16rebase(t, (simSFR[t->high] << 8) | simSFR[t->low]);
+}
+
+static void T16configWrite(uint8_t reg, uint8_t old)
+{
+    // Counted up to the write with the previous configuration
+    SimTimer16 *t = T16find(reg);
+    uint16_t count = T16count(t);
+
+    simSFR[t->low] = count & 0xFF;
+    simSFR[t->high] = count >> 8;
+    T16rebase(t, count);
+}
+
+void SimTMRinit()
+{
+    uint8_t i;
+
+    for (i = 0; i < TIMER16_COUNT; i++)
+    {
+        SimTimer16 *t = &timers16[i];
+
+        SimOnSync(t->low, T16sync);
+        SimOnSync(t->high, T16sync);
+        SimOnWrite(t->low, T16counterWrite);
+        SimOnWrite(t->high, T16counterWrite);
+        SimOnWrite(t->con, T16configWrite);
+        SimOnWrite(t->clk, T16configWrite);
+    }
+
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        uint8_t base = timers[i].base;
+
+        SimOnSync(base, TxSync);
+        SimOnWrite(base, TxCounterWrite);
+        SimOnWrite(base + TMR_CON, TxConfigWrite);
+        SimOnWrite(base + TMR_PR, TxConfigWrite);
+        SimOnWrite(base + TMR_CLKCON, TxConfigWrite);
+    }
+}
@@ -0,0 +1,378 @@
+/*
+ * File:   wiimote.c
+ * Author: Jackson Snowden
+ *
+ * Host side of the extension port. Waits for DETECT, runs the extension
+ * init sequence over the simulated I2C bus and then polls EXP_REG_DATA at
+ * the profile rate, handing each decoded report to the harness.
+ */
+
+#include <string.h>
+#include "pins.h"
+#include "config.h"
+#include "expansion.h"
+#include "MSSP.h"
+#include "wiimote.h"
+
+#define WII_DETECT_DELAY    SIM_TICKS_MS(2)     // Hot-plug settle time before the first transaction
+#define WII_BUS_GAP         SIM_TICKS_US(60)    // Idle time after each STOP
+#define WII_INIT_GAP        SIM_TICKS_US(500)   // Gap between init transactions
+#define WII_KEY_DELAY       SIM_TICKS_MS(10)    // Time given to the extension to build its tables
+#define WII_RETRY_DELAY     SIM_TICKS_MS(50)
+
+// Key exchange values, rand[] in the order GenEncryption() uses them
+#define WII_KEY_IDX 2
+static const uint8_t keyRand[10] = { 0x3A, 0x91, 0x0C, 0x6E, 0xD5, 0x27, 0xB8, 0x44, 0xF3, 0x19 };
+
+// Firmware key tables (crypto.c)
+extern const uint8_t ans[7][6];
+extern const uint8_t sboxes[10][256];
+
+// Classic Controller button bytes, bit 0 first (0xFF = unused)
+static const uint8_t classicBits[2][8] =
+{
+    { 0xFF, WII_BTN_R, WII_BTN_PLUS, WII_BTN_HOME, WII_BTN_MINUS, WII_BTN_L, WII_BTN_DD, WII_BTN_DR },
+    { WII_BTN_DU, WII_BTN_DL, WII_BTN_ZR, WII_BTN_X, WII_BTN_A, WII_BTN_Y, WII_BTN_B, WII_BTN_ZL },
+};
+
+const WiimoteProfile wiimoteProfiles[] =
+{
+    { "wii100", 100, 400000, 1, 0 },
+    { "wii200", 200, 400000, 1, 0 },
+    { "snes",    60, 400000, 0, 1 },    // Unencrypted, data format 3, one read per video frame
+    { NULL }
+};
+
+WiimoteStats wiimoteStats;
+
+static const WiimoteProfile *profile;
+static WiimoteReportFn reportFn;
+static SimSignal detect;
+static uint8_t *traceBuf;       // Frozen trace requested, read between polls
+static uint8_t traceDone;
+static uint8_t polling;
+static uint8_t classic;
+
+static uint8_t ft[8];
+static uint8_t sb[8];
+
+// - - - - - - - - - - //
+
+static uint8_t WiiROR(uint8_t a, uint8_t b)
+{
+    return (uint8_t)((a >> b) | (a << ((8 - b) & 7)));
+}
+
+static void WiimoteKeys(uint8_t *buf)
+{
+    const uint8_t *r = keyRand;
+    const uint8_t *a = ans[WII_KEY_IDX];
+    const uint8_t *s1 = sboxes[WII_KEY_IDX + 1];
+    const uint8_t *s2 = sboxes[WII_KEY_IDX + 2];
+    uint8_t s[10];
+    uint8_t key[6];
+    uint8_t i;
+
+    for (i = 0; i < 10; i++) s[i] = sboxes[0][r[i]];
+
+    // Same derivation the extension checks against in GenEncryption()
+    key[0] = (WiiROR(a[0] ^ s[5], s[2] % 8) - s[9]) ^ s[4];
+    key[1] = (WiiROR(a[1] ^ s[1], s[0] % 8) - s[5]) ^ s[7];
+    key[2] = (WiiROR(a[2] ^ s[6], s[8] % 8) - s[2]) ^ s[0];
+    key[3] = (WiiROR(a[3] ^ s[4], s[7] % 8) - s[3]) ^ s[2];
+    key[4] = (WiiROR(a[4] ^ s[1], s[6] % 8) - s[3]) ^ s[4];
+    key[5] = (WiiROR(a[5] ^ s[7], s[8] % 8) - s[5]) ^ s[9];
+
+    ft[0] = s1[key[4]] ^ s2[r[3]];
+    ft[1] = s1[key[2]] ^ s2[r[5]];
+    ft[2] = s1[key[5]] ^ s2[r[7]];
+    ft[3] = s1[key[0]] ^ s2[r[2]];
+    ft[4] = s1[key[1]] ^ s2[r[4]];
+    ft[5] = s1[key[3]] ^ s2[r[9]];
+    ft[6] = s1[r[0]] ^ s2[r[6]];
+    ft[7] = s1[r[1]] ^ s2[r[8]];
+
+    sb[0] = s1[key[0]] ^ s2[r[1]];
+    sb[1] = s1[key[5]] ^ s2[r[4]];
+    sb[2] = s1[key[3]] ^ s2[r[0]];
+    sb[3] = s1[key[2]] ^ s2[r[9]];
+    sb[4] = s1[key[4]] ^ s2[r[7]];
+    sb[5] = s1[key[1]] ^ s2[r[8]];
+    sb[6] = s1[r[3]] ^ s2[r[5]];
+    sb[7] = s1[r[2]] ^ s2[r[6]];
+
+    // Register layout expected by InitKeys()
+    for (i = 0; i < 10; i++) buf[i] = r[9 - i];
+    for (i = 0; i < 6; i++) buf[i + 10] = key[5 - i];
+}
+
+// - - - - - - - - - - //
+
+static uint8_t WiiWrite(uint8_t reg, const uint8_t *data, uint8_t length)
+{
+    uint8_t ok;
+    uint8_t i;
+
+    SimI2Cstart();
+    ok = SimI2Cwrite(EXP_I2C_ADDR << 1);
+    if (ok) ok = SimI2Cwrite(reg);
+
+    for (i = 0; ok && (i < length); i++)
+    {
+        uint8_t a = reg + i;
+
+        // Writes are encrypted once the key exchange is done
+        if (wiimoteStats.encrypted) ok = SimI2Cwrite((data[i] - ft[a % 8]) ^ sb[a % 8]);
+        else ok = SimI2Cwrite(data[i]);
+    }
+
+    SimI2Cstop();
+    SimWait(WII_BUS_GAP);
+
+    if (!ok) wiimoteStats.busErrors++;
+    return ok;
+}
+
+static uint8_t WiiWriteByte(uint8_t reg, uint8_t data)
+{
+    return WiiWrite(reg, &data, 1);
+}
+
+static uint8_t WiiRead(uint8_t reg, uint8_t *data, uint8_t length)
+{
+    uint8_t i;
+
+    // Set the register pointer, then read in a separate transaction
+    if (!WiiWrite(reg, NULL, 0)) return 0;
+
+    SimI2Cstart();
+    if (!SimI2Cwrite((EXP_I2C_ADDR << 1) | 1))
+    {
+        SimI2Cstop();
+        SimWait(WII_BUS_GAP);
+        wiimoteStats.busErrors++;
+        return 0;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        uint8_t a = reg + i;
+        uint8_t d = SimI2Cread(i < (length - 1));
+
+        if (wiimoteStats.encrypted) d = (d ^ sb[a % 8]) + ft[a % 8];
+        data[i] = d;
+    }
+
+    SimI2Cstop();
+    SimWait(WII_BUS_GAP);
+    return 1;
+}
+
+// - - - - - - - - - - //
+
+static void WiimoteDecode(const uint8_t *buf, WiimoteReport *r)
+{
+    const uint8_t *btn;
+    uint8_t i;
+    uint8_t b;
+
+    r->buttons = 0;
+    for (i = 0; i < WII_AXES; i++) r->axis[i] = 0;
+
+    if (!classic)
+    {
+        r->axis[WII_AX_LX] = buf[0];
+        r->axis[WII_AX_LY] = buf[1];
+        if (!(buf[5] & 0x01)) r->buttons |= 1UL << WII_BTN_Z;
+        if (!(buf[5] & 0x02)) r->buttons |= 1UL << WII_BTN_C;
+        return;
+    }
+
+    if (wiimoteStats.reportSize == 8)
+    {
+        r->axis[WII_AX_LX] = buf[0];
+        r->axis[WII_AX_RX] = buf[1];
+        r->axis[WII_AX_LY] = buf[2];
+        r->axis[WII_AX_RY] = buf[3];
+        r->axis[WII_AX_LT] = buf[4];
+        r->axis[WII_AX_RT] = buf[5];
+        btn = &buf[6];
+    }
+    else
+    {
+        r->axis[WII_AX_LX] = (buf[0] & 0x3F) << 2;
+        r->axis[WII_AX_LY] = (buf[1] & 0x3F) << 2;
+        r->axis[WII_AX_RX] = (((buf[0] & 0xC0) >> 3) | ((buf[1] & 0xC0) >> 5) | ((buf[2] & 0x80) >> 7)) << 3;
+        r->axis[WII_AX_RY] = (buf[2] & 0x1F) << 3;
+        r->axis[WII_AX_LT] = (((buf[2] & 0x60) >> 2) | ((buf[3] & 0xE0) >> 5)) << 3;
+        r->axis[WII_AX_RT] = (buf[3] & 0x1F) << 3;
+        btn = &buf[4];
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        for (b = 0; b < 8; b++)
+        {
+            if ((classicBits[i][b] != 0xFF) && !(btn[i] & (1 << b))) r->buttons |= 1UL << classicBits[i][b];
+        }
+    }
+}
+
+static uint8_t WiimoteConnect()
+{
+    uint8_t buf[16];
+
+    wiimoteStats.encrypted = 0;
+    wiimoteStats.reportSize = 6;
+
+    // Unencrypted init
+    if (!WiiWriteByte(EXP_REG_SETUP1, 0x55)) return 0;
+    SimWait(WII_INIT_GAP);
+    if (!WiiWriteByte(EXP_REG_SETUP2, 0x00)) return 0;
+    SimWait(WII_INIT_GAP);
+
+    if (!WiiRead(EXP_REG_ID, wiimoteStats.id, 6)) return 0;
+    classic = (wiimoteStats.id[4] == 0x01) && (wiimoteStats.id[5] == 0x01);
+    SimWait(WII_INIT_GAP);
+
+    if (profile->encrypt)
+    {
+        if (!WiiWriteByte(EXP_REG_SETUP1, 0xAA)) return 0;
+        SimWait(WII_INIT_GAP);
+
+        WiimoteKeys(buf);
+        if (!WiiWrite(EXP_REG_KEY, &buf[0], 6)) return 0;
+        if (!WiiWrite(EXP_REG_KEY + 6, &buf[6], 6)) return 0;
+        if (!WiiWrite(EXP_REG_KEY + 12, &buf[12], 4)) return 0;
+
+        wiimoteStats.encrypted = 1;
+        SimWait(WII_KEY_DELAY);
+    }
+
+    if (profile->fullMode)
+    {
+        if (!WiiWriteByte(EXP_REG_ID + 4, 3)) return 0;
+        SimWait(WII_INIT_GAP);
+
+        // Use the 8 byte format only if the extension reports it back
+        if (!WiiRead(EXP_REG_ID, buf, 6)) return 0;
+        if (classic && (buf[4] == 3)) wiimoteStats.reportSize = 8;
+        SimWait(WII_INIT_GAP);
+    }
+
+    return 1;
+}
+
+static void WiimotePoll()
+{
+    uint8_t buf[8];
+    WiimoteReport r;
+
+    if (!WiiRead(EXP_REG_DATA, buf, wiimoteStats.reportSize)) return;
+
+    r.time = simTime;
+    WiimoteDecode(buf, &r);
+
+    wiimoteStats.polls++;
+    if (!wiimoteStats.firstReport) wiimoteStats.firstReport = simTime;
+    if (reportFn) reportFn(&r);
+}
+
+static void WiimoteTrace()
+{
+    uint8_t page;
+
+    // The same page-and-read sequence a host tool would use
+    for (page = 0; page < I2C_TRACE_SIZE / I2C_TRACE_WINDOW; page++)
+    {
+        if (!WiiWriteByte(EXP_REG_TRACE_PAGE, page)) return;
+        if (!WiiRead(EXP_REG_TRACE, traceBuf + page * I2C_TRACE_WINDOW, I2C_TRACE_WINDOW)) return;
+    }
+
+    traceBuf = NULL;
+    traceDone = 1;
+}
+
+static void WiimoteMain(void *arg)
+{
+    SimTime period = SIM_HFINTOSC / profile->pollHz;
+
+    while (1)
+    {
+        SimTime next;
+
+        polling = 0;
+        while (!SimPinGet(DETECT)) SimWaitSignal(&detect, SIM_TICKS_MS(1000));
+
+        SimWait(WII_DETECT_DELAY);
+        if (!SimPinGet(DETECT)) continue;
+
+        if (!WiimoteConnect())
+        {
+            SimWait(WII_RETRY_DELAY);
+            continue;
+        }
+
+        wiimoteStats.connects++;
+        polling = 1;
+
+        next = simTime;
+        while (SimPinGet(DETECT))
+        {
+            WiimotePoll();
+            if (traceBuf) WiimoteTrace();
+
+            next += period;
+            if (next < simTime) next = simTime;
+            SimWaitUntil(next);
+        }
+    }
+}
+
+static void WiimotePin(uint8_t port, uint8_t bit, uint8_t level)
+{
+    if ((port == DETECT.port) && (bit == DETECT.bit)) SimNotify(&detect);
+}
+
+// - - - - - - - - - - //
+
+const WiimoteProfile *WiimoteFindProfile(const char *name)
+{
+    const WiimoteProfile *p;
+
+    for (p = wiimoteProfiles; p->name; p++)
+    {
+        if (!strcmp(p->name, name)) return p;
+    }
+
+    return NULL;
+}
+
+void WiimoteInit(const WiimoteProfile *p, WiimoteReportFn onReport)
+{
+    profile = p;
+    reportFn = onReport;
+
+    // Wii Remote side pull-down on the detect line
+    SimPinSet(DETECT, 0);
+
+    SimI2CsetClock(p->busHz);
+    SimOnPinOutput(WiimotePin);
+    SimThreadCreate(WiimoteMain, NULL);
+}
+
+uint8_t WiimoteIsPolling()
+{
+    return polling;
+}
+
+void WiimoteTraceRead(uint8_t *ring)
+{
+    traceDone = 0;
+    traceBuf = ring;
+}
+
+uint8_t WiimoteTraceDone()
+{
+    return traceDone;
+}
@@ -0,0 +1,88 @@
+/*
+ * File:   wiimote.h
+ * Author: Jackson Snowden
+ */
+
+#ifndef _WIIMOTE_H_
+#define	_WIIMOTE_H_
+
+#include "periph.h"
+
+// Host polling profile
+typedef struct
+{
+    const char *name;
+    uint32_t pollHz;        // Report reads per second
+    uint32_t busHz;         // I2C clock
+    uint8_t encrypt;        // Key exchange after the ID read
+    uint8_t fullMode;       // Request data format 3 through EXP_REG_ID + 4
+}
+WiimoteProfile;
+
+extern const WiimoteProfile wiimoteProfiles[];
+
+// Decoded report fields, buttons are active high
+#define WII_BTN_A       0
+#define WII_BTN_B       1
+#define WII_BTN_X       2
+#define WII_BTN_Y       3
+#define WII_BTN_DU      4
+#define WII_BTN_DD      5
+#define WII_BTN_DR      6
+#define WII_BTN_DL      7
+#define WII_BTN_R       8
+#define WII_BTN_ZR      9
+#define WII_BTN_L       10
+#define WII_BTN_ZL      11
+#define WII_BTN_PLUS    12
+#define WII_BTN_MINUS   13
+#define WII_BTN_HOME    14
+#define WII_BTN_C       15
+#define WII_BTN_Z       16
+
+// Axes are scaled to 8 bits whatever the report resolution
+#define WII_AX_LX       0
+#define WII_AX_LY       1
+#define WII_AX_RX       2
+#define WII_AX_RY       3
+#define WII_AX_LT       4
+#define WII_AX_RT       5
+#define WII_AXES        6
+
+typedef struct
+{
+    SimTime time;           // End of the read transaction
+    uint32_t buttons;
+    uint8_t axis[WII_AXES];
+}
+WiimoteReport;
+
+typedef struct
+{
+    uint32_t connects;
+    uint32_t polls;
+    uint32_t busErrors;
+    SimTime firstReport;
+    uint8_t id[6];
+    uint8_t encrypted;
+    uint8_t reportSize;
+}
+WiimoteStats;
+
+typedef void (*WiimoteReportFn)(const WiimoteReport *report);
+
+extern WiimoteStats wiimoteStats;
+
+const WiimoteProfile *WiimoteFindProfile(const char *name);
+
+void WiimoteInit(const WiimoteProfile *profile, WiimoteReportFn onReport);
+
+uint8_t WiimoteIsPolling();
+
+// Reads the frozen I2C trace through its register window between polls,
+// ring receives I2C_TRACE_SIZE bytes
+void WiimoteTraceRead(uint8_t *ring);
+
+uint8_t WiimoteTraceDone();
+
+#endif  /* _WIIMOTE_H_ */
@@ -0,0 +1,304 @@
+/*
+ * File:   xc.h
+ * Author: Jackson Snowden
+ *
+ * Host stand-in for the XC8 device header. Every SFR name expands to an
+ * access through the simulator so peripheral models see reads and writes
+ * in program order and the virtual cycle counter advances with each one.
+ */
+
+#ifndef _XC_H_
+#define	_XC_H_
+
+#include <stdint.h>
+#include "sim.h"
+
+#define SIM_SFR(r)      (*SimAccess(SFR_##r))
+#define SIM_BITS(r)     (*(volatile r##bits_t *)SimAccess(SFR_##r))
+#define SIM_BUF(r)      (*SimAccessBuf(SFR_##r))
+
+// Compiler intrinsics
+#define interrupt
+#define NOP()           SimDelay(1)
+#define CLRWDT()        SimDelay(1)
+#define SLEEP()         SimSleep()
+#define di()            (INTCONbits.GIE = 0)
+#define ei()            (INTCONbits.GIE = 1)
+#define __delay_us(x)   SimDelay((uint32_t)((x) * (_XTAL_FREQ / 4000000.0)))
+#define __delay_ms(x)   SimDelay((uint32_t)((x) * (_XTAL_FREQ / 4000.0)))
+
+// Register bit definitions
+#define SIM_PORT_BITS(p) \
+    typedef struct { uint8_t R##p##0:1; uint8_t R##p##1:1; uint8_t R##p##2:1; uint8_t R##p##3:1; \
+                     uint8_t R##p##4:1; uint8_t R##p##5:1; uint8_t R##p##6:1; uint8_t R##p##7:1; } PORT##p##bits_t; \
+    typedef struct { uint8_t LAT##p##0:1; uint8_t LAT##p##1:1; uint8_t LAT##p##2:1; uint8_t LAT##p##3:1; \
+                     uint8_t LAT##p##4:1; uint8_t LAT##p##5:1; uint8_t LAT##p##6:1; uint8_t LAT##p##7:1; } LAT##p##bits_t;
+
+SIM_PORT_BITS(A)
+SIM_PORT_BITS(B)
+SIM_PORT_BITS(C)
+SIM_PORT_BITS(D)
+SIM_PORT_BITS(E)
+
+typedef struct { uint8_t INTEDG:1; uint8_t :5; uint8_t PEIE:1; uint8_t GIE:1; } INTCONbits_t;
+typedef struct { uint8_t INTF:1; uint8_t :3; uint8_t IOCIF:1; uint8_t TMR0IF:1; uint8_t :2; } PIR0bits_t;
+typedef struct { uint8_t INTE:1; uint8_t :3; uint8_t IOCIE:1; uint8_t TMR0IE:1; uint8_t :2; } PIE0bits_t;
+typedef struct { uint8_t ADIF:1; uint8_t ADTIF:1; uint8_t :4; uint8_t CSWIF:1; uint8_t OSFIF:1; } PIR1bits_t;
+typedef struct { uint8_t ADIE:1; uint8_t ADTIE:1; uint8_t :4; uint8_t CSWIE:1; uint8_t OSFIE:1; } PIE1bits_t;
+typedef struct { uint8_t SSP1IF:1; uint8_t BCL1IF:1; uint8_t SSP2IF:1; uint8_t BCL2IF:1; uint8_t TX1IF:1; uint8_t RC1IF:1; uint8_t :2; } PIR3bits_t;
+typedef struct { uint8_t SSP1IE:1; uint8_t BCL1IE:1; uint8_t SSP2IE:1; uint8_t BCL2IE:1; uint8_t TX1IE:1; uint8_t RC1IE:1; uint8_t :2; } PIE3bits_t;
+typedef struct { uint8_t TMR1IF:1; uint8_t TMR2IF:1; uint8_t TMR3IF:1; uint8_t TMR4IF:1; uint8_t TMR5IF:1; uint8_t TMR6IF:1; uint8_t :2; } PIR4bits_t;
+typedef struct { uint8_t TMR1IE:1; uint8_t TMR2IE:1; uint8_t TMR3IE:1; uint8_t TMR4IE:1; uint8_t TMR5IE:1; uint8_t TMR6IE:1; uint8_t :2; } PIE4bits_t;
+typedef struct { uint8_t NDIV:4; uint8_t NOSC:3; uint8_t :1; } OSCCON1bits_t;
+typedef struct { uint8_t DOZE:3; uint8_t :1; uint8_t DOE:1; uint8_t ROI:1; uint8_t DOZEN:1; uint8_t IDLEN:1; } CPUDOZEbits_t;
+typedef struct { uint8_t PPSLOCKED:1; uint8_t :7; } PPSLOCKbits_t;
+typedef struct { uint8_t ADGO:1; uint8_t :1; uint8_t ADFM:1; uint8_t :1; uint8_t ADCS:1; uint8_t :1; uint8_t ADCONT:1; uint8_t ADON:1; } ADCON0bits_t;
+typedef struct { uint8_t ADDSEN:1; uint8_t :4; uint8_t ADGPOL:1; uint8_t ADIPEN:1; uint8_t ADPPOL:1; } ADCON1bits_t;
+typedef struct { uint8_t ADMD:3; uint8_t ADACLR:1; uint8_t ADCRS:3; uint8_t ADPSIS:1; } ADCON2bits_t;
+typedef struct { uint8_t ADTMD:3; uint8_t ADSOI:1; uint8_t ADCALC:3; uint8_t :1; } ADCON3bits_t;
+typedef struct { uint8_t ADSTAT:3; uint8_t :1; uint8_t ADMATH:1; uint8_t ADLTHR:1; uint8_t ADUTHR:1; uint8_t ADAOV:1; } ADSTATbits_t;
+typedef struct { uint8_t RD:1; uint8_t WR:1; uint8_t WREN:1; uint8_t WRERR:1; uint8_t FREE:1; uint8_t LWLO:1; uint8_t NVMREGS:1; uint8_t :1; } NVMCON1bits_t;
+typedef struct { uint8_t BF:1; uint8_t UA:1; uint8_t R_nW:1; uint8_t S:1; uint8_t P:1; uint8_t D_nA:1; uint8_t CKE:1; uint8_t SMP:1; } SSP1STATbits_t;
+typedef struct { uint8_t SSPM:4; uint8_t CKP:1; uint8_t SSPEN:1; uint8_t SSPOV:1; uint8_t WCOL:1; } SSP1CON1bits_t;
+typedef struct { uint8_t SEN:1; uint8_t RSEN:1; uint8_t PEN:1; uint8_t RCEN:1; uint8_t ACKEN:1; uint8_t ACKDT:1; uint8_t ACKSTAT:1; uint8_t GCEN:1; } SSP1CON2bits_t;
+typedef struct { uint8_t DHEN:1; uint8_t AHEN:1; uint8_t SBCDE:1; uint8_t SDAHT:1; uint8_t BOEN:1; uint8_t SCIE:1; uint8_t PCIE:1; uint8_t ACKTIM:1; } SSP1CON3bits_t;
+typedef SSP1STATbits_t SSP2STATbits_t;
+typedef SSP1CON1bits_t SSP2CON1bits_t;
+typedef SSP1CON2bits_t SSP2CON2bits_t;
+typedef SSP1CON3bits_t SSP2CON3bits_t;
+typedef struct { uint8_t ON:1; uint8_t RD16:1; uint8_t nSYNC:1; uint8_t :1; uint8_t CKPS:2; uint8_t :2; } T1CONbits_t;
+typedef T1CONbits_t T3CONbits_t;
+typedef struct { uint8_t OUTPS:4; uint8_t CKPS:3; uint8_t ON:1; } T2CONbits_t;
+typedef T2CONbits_t T4CONbits_t;
+
+// Registers
+#define PORTA       SIM_SFR(PORTA)
+#define PORTB       SIM_SFR(PORTB)
+#define PORTC       SIM_SFR(PORTC)
+#define PORTD       SIM_SFR(PORTD)
+#define PORTE       SIM_SFR(PORTE)
+#define LATA        SIM_SFR(LATA)
+#define LATB        SIM_SFR(LATB)
+#define LATC        SIM_SFR(LATC)
+#define LATD        SIM_SFR(LATD)
+#define LATE        SIM_SFR(LATE)
+#define TRISA       SIM_SFR(TRISA)
+#define TRISB       SIM_SFR(TRISB)
+#define TRISC       SIM_SFR(TRISC)
+#define TRISD       SIM_SFR(TRISD)
+#define TRISE       SIM_SFR(TRISE)
+#define ANSELA      SIM_SFR(ANSELA)
+#define ANSELB      SIM_SFR(ANSELB)
+#define ANSELC      SIM_SFR(ANSELC)
+#define ANSELD      SIM_SFR(ANSELD)
+#define ANSELE      SIM_SFR(ANSELE)
+#define WPUA        SIM_SFR(WPUA)
+#define WPUB        SIM_SFR(WPUB)
+#define WPUC        SIM_SFR(WPUC)
+#define WPUD        SIM_SFR(WPUD)
+#define WPUE        SIM_SFR(WPUE)
+#define IOCAP       SIM_SFR(IOCAP)
+#define IOCAN       SIM_SFR(IOCAN)
+#define IOCAF       SIM_SFR(IOCAF)
+#define IOCBP       SIM_SFR(IOCBP)
+#define IOCBN       SIM_SFR(IOCBN)
+#define IOCBF       SIM_SFR(IOCBF)
+#define IOCCP       SIM_SFR(IOCCP)
+#define IOCCN       SIM_SFR(IOCCN)
+#define IOCCF       SIM_SFR(IOCCF)
+#define IOCEP       SIM_SFR(IOCEP)
+#define IOCEN       SIM_SFR(IOCEN)
+#define IOCEF       SIM_SFR(IOCEF)
+#define INTCON      SIM_SFR(INTCON)
+#define PIR0        SIM_SFR(PIR0)
+#define PIR1        SIM_SFR(PIR1)
+#define PIR3        SIM_SFR(PIR3)
+#define PIR4        SIM_SFR(PIR4)
+#define PIE0        SIM_SFR(PIE0)
+#define PIE1        SIM_SFR(PIE1)
+#define PIE3        SIM_SFR(PIE3)
+#define PIE4        SIM_SFR(PIE4)
+#define OSCCON1     SIM_SFR(OSCCON1)
+#define OSCFRQ      SIM_SFR(OSCFRQ)
+#define CPUDOZE     SIM_SFR(CPUDOZE)
+#define PPSLOCK     SIM_SFR(PPSLOCK)
+#define SSP1DATPPS  SIM_SFR(SSP1DATPPS)
+#define SSP1CLKPPS  SIM_SFR(SSP1CLKPPS)
+#define SSP2DATPPS  SIM_SFR(SSP2DATPPS)
+#define RB0PPS      SIM_SFR(RB0PPS)
+#define RB1PPS      SIM_SFR(RB1PPS)
+#define RB2PPS      SIM_SFR(RB2PPS)
+#define RB3PPS      SIM_SFR(RB3PPS)
+#define RB4PPS      SIM_SFR(RB4PPS)
+#define ADCON0      SIM_SFR(ADCON0)
+#define ADCON1      SIM_SFR(ADCON1)
+#define ADCON2      SIM_SFR(ADCON2)
+#define ADCON3      SIM_SFR(ADCON3)
+#define ADCLK       SIM_SFR(ADCLK)
+#define ADREF       SIM_SFR(ADREF)
+#define ADPRE       SIM_SFR(ADPRE)
+#define ADACQ       SIM_SFR(ADACQ)
+#define ADCAP       SIM_SFR(ADCAP)
+#define ADPCH       SIM_SFR(ADPCH)
+#define ADRPT       SIM_SFR(ADRPT)
+#define ADCNT       SIM_SFR(ADCNT)
+#define ADSTAT      SIM_SFR(ADSTAT)
+#define ADACT       SIM_SFR(ADACT)
+#define ADRESH      SIM_SFR(ADRESH)
+#define ADRESL      SIM_SFR(ADRESL)
+#define ADPREVH     SIM_SFR(ADPREVH)
+#define ADPREVL     SIM_SFR(ADPREVL)
+#define ADACCU      SIM_SFR(ADACCU)
+#define ADACCH      SIM_SFR(ADACCH)
+#define ADACCL      SIM_SFR(ADACCL)
+#define ADFLTRH     SIM_SFR(ADFLTRH)
+#define ADFLTRL     SIM_SFR(ADFLTRL)
+#define ADSTPTH     SIM_SFR(ADSTPTH)
+#define ADSTPTL     SIM_SFR(ADSTPTL)
+#define ADERRH      SIM_SFR(ADERRH)
+#define ADERRL      SIM_SFR(ADERRL)
+#define ADLTHH      SIM_SFR(ADLTHH)
+#define ADLTHL      SIM_SFR(ADLTHL)
+#define ADUTHH      SIM_SFR(ADUTHH)
+#define ADUTHL      SIM_SFR(ADUTHL)
+#define NVMCON1     SIM_SFR(NVMCON1)
+#define NVMCON2     SIM_SFR(NVMCON2)
+#define NVMADRH     SIM_SFR(NVMADRH)
+#define NVMADRL     SIM_SFR(NVMADRL)
+#define NVMDATH     SIM_SFR(NVMDATH)
+#define NVMDATL     SIM_SFR(NVMDATL)
+#define SSP1BUF     SIM_BUF(SSP1BUF)
+#define SSP1ADD     SIM_SFR(SSP1ADD)
+#define SSP1MSK     SIM_SFR(SSP1MSK)
+#define SSP1STAT    SIM_SFR(SSP1STAT)
+#define SSP1CON1    SIM_SFR(SSP1CON1)
+#define SSP1CON2    SIM_SFR(SSP1CON2)
+#define SSP1CON3    SIM_SFR(SSP1CON3)
+#define SSP2BUF     SIM_BUF(SSP2BUF)
+#define SSP2ADD     SIM_SFR(SSP2ADD)
+#define SSP2MSK     SIM_SFR(SSP2MSK)
+#define SSP2STAT    SIM_SFR(SSP2STAT)
+#define SSP2CON1    SIM_SFR(SSP2CON1)
+#define SSP2CON2    SIM_SFR(SSP2CON2)
+#define SSP2CON3    SIM_SFR(SSP2CON3)
+#define T1CON       SIM_SFR(T1CON)
+#define T1GCON      SIM_SFR(T1GCON)
+#define T1CLK       SIM_SFR(T1CLK)
+#define TMR1H       SIM_SFR(TMR1H)
+#define TMR1L       SIM_SFR(TMR1L)
+#define T3CON       SIM_SFR(T3CON)
+#define T3GCON      SIM_SFR(T3GCON)
+#define T3CLK       SIM_SFR(T3CLK)
+#define TMR3H       SIM_SFR(TMR3H)
+#define TMR3L       SIM_SFR(TMR3L)
+#define T2TMR       SIM_SFR(T2TMR)
+#define TMR2        SIM_SFR(T2TMR)
+#define T2PR        SIM_SFR(T2PR)
+#define PR2         SIM_SFR(T2PR)
+#define T2CON       SIM_SFR(T2CON)
+#define T2HLT       SIM_SFR(T2HLT)
+#define T2CLKCON    SIM_SFR(T2CLKCON)
+#define T2RST       SIM_SFR(T2RST)
+#define T4TMR       SIM_SFR(T4TMR)
+#define TMR4        SIM_SFR(T4TMR)
+#define T4PR        SIM_SFR(T4PR)
+#define PR4         SIM_SFR(T4PR)
+#define T4CON       SIM_SFR(T4CON)
+#define T4HLT       SIM_SFR(T4HLT)
+#define T4CLKCON    SIM_SFR(T4CLKCON)
+#define T4RST       SIM_SFR(T4RST)
+
+#define PORTAbits   SIM_BITS(PORTA)
+#define PORTBbits   SIM_BITS(PORTB)
+#define PORTCbits   SIM_BITS(PORTC)
+#define PORTDbits   SIM_BITS(PORTD)
+#define PORTEbits   SIM_BITS(PORTE)
+#define LATAbits    SIM_BITS(LATA)
+#define LATBbits    SIM_BITS(LATB)
+#define LATCbits    SIM_BITS(LATC)
+#define LATDbits    SIM_BITS(LATD)
+#define LATEbits    SIM_BITS(LATE)
+#define INTCONbits  SIM_BITS(INTCON)
+#define PIR0bits    SIM_BITS(PIR0)
+#define PIE0bits    SIM_BITS(PIE0)
+#define PIR1bits    SIM_BITS(PIR1)
+#define PIE1bits    SIM_BITS(PIE1)
+#define PIR3bits    SIM_BITS(PIR3)
+#define PIE3bits    SIM_BITS(PIE3)
+#define PIR4bits    SIM_BITS(PIR4)
+#define PIE4bits    SIM_BITS(PIE4)
+#define OSCCON1bits SIM_BITS(OSCCON1)
+#define CPUDOZEbits SIM_BITS(CPUDOZE)
+#define PPSLOCKbits SIM_BITS(PPSLOCK)
+#define ADCON0bits  SIM_BITS(ADCON0)
+#define ADCON1bits  SIM_BITS(ADCON1)
+#define ADCON2bits  SIM_BITS(ADCON2)
+#define ADCON3bits  SIM_BITS(ADCON3)
+#define ADSTATbits  SIM_BITS(ADSTAT)
+#define NVMCON1bits SIM_BITS(NVMCON1)
+#define SSP1STATbits SIM_BITS(SSP1STAT)
+#define SSP1CON1bits SIM_BITS(SSP1CON1)
+#define SSP1CON2bits SIM_BITS(SSP1CON2)
+#define SSP1CON3bits SIM_BITS(SSP1CON3)
+#define SSP2STATbits SIM_BITS(SSP2STAT)
+#define SSP2CON1bits SIM_BITS(SSP2CON1)
+#define SSP2CON2bits SIM_BITS(SSP2CON2)
+#define SSP2CON3bits SIM_BITS(SSP2CON3)
+#define T1CONbits   SIM_BITS(T1CON)
+#define T3CONbits   SIM_BITS(T3CON)
+#define T2CONbits   SIM_BITS(T2CON)
+#define T4CONbits   SIM_BITS(T4CON)
+
+// Single-bit aliases
+#define RA0     PORTAbits.RA0
+#define RA1     PORTAbits.RA1
+#define RA2     PORTAbits.RA2
+#define RA3     PORTAbits.RA3
+#define RA4     PORTAbits.RA4
+#define RA5     PORTAbits.RA5
+#define RA6     PORTAbits.RA6
+#define RA7     PORTAbits.RA7
+#define RB0     PORTBbits.RB0
+#define RB1     PORTBbits.RB1
+#define RB2     PORTBbits.RB2
+#define RB3     PORTBbits.RB3
+#define RB4     PORTBbits.RB4
+#define RB5     PORTBbits.RB5
+#define RB6     PORTBbits.RB6
+#define RB7     PORTBbits.RB7
+#define RC0     PORTCbits.RC0
+#define RC1     PORTCbits.RC1
+#define RC2     PORTCbits.RC2
+#define RC3     PORTCbits.RC3
+#define RC4     PORTCbits.RC4
+#define RC5     PORTCbits.RC5
+#define RC6     PORTCbits.RC6
+#define RC7     PORTCbits.RC7
+#define RD0     PORTDbits.RD0
+#define RD1     PORTDbits.RD1
+#define RD2     PORTDbits.RD2
+#define RD3     PORTDbits.RD3
+#define RD4     PORTDbits.RD4
+#define RD5     PORTDbits.RD5
+#define RD6     PORTDbits.RD6
+#define RD7     PORTDbits.RD7
+#define RE0     PORTEbits.RE0
+#define RE1     PORTEbits.RE1
+#define RE2     PORTEbits.RE2
+#define RE3     PORTEbits.RE3
+#define LATB0   LATBbits.LATB0
+#define LATB1   LATBbits.LATB1
+#define LATB2   LATBbits.LATB2
+#define LATB3   LATBbits.LATB3
+#define LATB4   LATBbits.LATB4
+#define LATB5   LATBbits.LATB5
+#define SSP1IF  PIR3bits.SSP1IF
+#define SSP2IF  PIR3bits.SSP2IF
+#define IOCIF   PIR0bits.IOCIF
+#define ADIF    PIR1bits.ADIF
+#define ADTIF   PIR1bits.ADTIF
+#define TMR1IF  PIR4bits.TMR1IF
+#define TMR2IF  PIR4bits.TMR2IF
+#define TMR4IF  PIR4bits.TMR4IF
+
+#endif  /* _XC_H_ */